@@ -8,6 +8,9 @@ config :gitgud,
 # Configure Telemetry prefix for Ecto repository GitGud.DB
 config :gitgud, GitGud.DB, telemetry_prefix: [:gitgud, :db]
 
+# Configure Git agents to share a bounded cache per repository, persisting OID-keyed results on disk
+config :gitrekt, GitRekt.GitAgent, cache_adapter: GitRekt.Cache.Disk
+
 # Import environment specific config. This must remain at the bottom
 # of this file so it overrides the configuration defined above.
 import_config "#{Mix.env}.exs"
@@ -7,6 +7,10 @@ defmodule GitGud.Application do
 
     telemetry_attach_git_agent()
     telemetry_attach_git_wire_protocol()
+    telemetry_attach_git_cache()
+    telemetry_attach_git_refdb()
+    telemetry_attach_git_library()
+    telemetry_attach_git_nif()
     telemetry_attach_graphql()
 
     children = [
@@ -14,6 +18,7 @@ defmodule GitGud.Application do
       {GitGud.DB, []},
       {GitGud.RepoSupervisor, []},
       {GitGud.SSHServer, []},
+      {GitGud.Telemetry.GitNIFPoller, []},
     ]
     Supervisor.start_link(children, strategy: :one_for_one, name: GitGud.Supervisor)
   end
@@ -45,6 +50,45 @@ defmodule GitGud.Application do
     )
   end
 
+  defp telemetry_attach_git_cache do
+    :telemetry.attach_many("git-cache",
+      [
+        [:gitrekt, :cache, :hit],
+        [:gitrekt, :cache, :miss],
+        [:gitrekt, :cache, :evict],
+        [:gitrekt, :disk_cache, :hit],
+        [:gitrekt, :disk_cache, :miss],
+        [:gitrekt, :disk_cache, :load],
+        [:gitrekt, :disk_cache, :compact]
+      ],
+      &GitGud.Telemetry.GitLoggerHandler.handle_event/4, %{}
+    )
+  end
+
+  defp telemetry_attach_git_refdb do
+    :telemetry.attach_many("git-refdb",
+      [
+        [:gitrekt, :refdb, :loose_refs],
+        [:gitrekt, :refdb, :compress]
+      ],
+      &GitGud.Telemetry.GitLoggerHandler.handle_event/4, %{}
+    )
+  end
+
+  defp telemetry_attach_git_library do
+    :telemetry.attach("git-library", [:gitrekt, :library, :memory], &GitGud.Telemetry.GitLoggerHandler.handle_event/4, %{})
+  end
+
+  defp telemetry_attach_git_nif do
+    :telemetry.attach_many("git-nif",
+      [
+        [:gitrekt, :nif, :stats],
+        [:gitrekt, :async, :stats]
+      ],
+      &GitGud.Telemetry.GitLoggerHandler.handle_event/4, %{}
+    )
+  end
+
   defp telemetry_attach_graphql do
     :telemetry.attach("graphql", [:absinthe, :execute, :operation, :stop], &GitGud.Telemetry.GraphQLLoggerHandler.handle_event/4, %{})
   end
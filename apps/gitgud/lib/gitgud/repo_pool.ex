@@ -12,6 +12,8 @@ defmodule GitGud.RepoPool do
 
   @agent_idle_timeout Application.compile_env(:gitgud, [__MODULE__, :idle_timeout], 1_800_000)
   @max_children_per_pool Application.compile_env(:gitgud, [__MODULE__, :max_children_per_pool], 5)
+  @agent_refdb_cache Application.compile_env(:gitgud, [__MODULE__, :refdb_cache], false)
+  @agent_shared_odb Application.compile_env(:gitgud, [__MODULE__, :shared_odb], true)
 
   @doc """
   Starts the pool as part of a supervision tree.
@@ -75,8 +77,9 @@ defmodule GitGud.RepoPool do
       extra_arguments: [
         Path.join(Keyword.fetch!(Application.get_env(:gitgud, RepoStorage), :git_root), path),
         [
-          cache: :ets.new(Module.concat(__MODULE__, Cache), [:set, :public]),
-          idle_timeout: @agent_idle_timeout
+          idle_timeout: @agent_idle_timeout,
+          refdb_cache: @agent_refdb_cache,
+          shared_odb: @agent_shared_odb
         ]
       ]
     )
@@ -4,6 +4,8 @@ defmodule GitGud.RepoSupervisor do
   """
   use Supervisor
 
+  alias GitRekt.Cache
+
   alias GitGud.RepoPool
   alias GitGud.RepoStorage
 
@@ -48,6 +50,8 @@ defmodule GitGud.RepoSupervisor do
       {:ok, volume} ->
         children = [
           {RepoStorage, volume},
+          {Cache.LRU, Application.get_env(:gitgud, Cache.LRU, [])},
+          {Cache.Disk, disk_cache_opts()},
           {RepoPool, volume},
         ]
         Supervisor.init(children, strategy: :one_for_one)
@@ -55,4 +59,13 @@ defmodule GitGud.RepoSupervisor do
         {:stop, reason}
     end
   end
+
+  #
+  # Helpers
+  #
+
+  defp disk_cache_opts do
+    git_root = Keyword.fetch!(Application.get_env(:gitgud, RepoStorage), :git_root)
+    Keyword.put_new(Application.get_env(:gitgud, Cache.Disk, []), :path, Path.join(git_root, ".result-cache"))
+  end
 end
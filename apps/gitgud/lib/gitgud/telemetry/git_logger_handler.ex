@@ -44,6 +44,58 @@ defmodule GitGud.Telemetry.GitLoggerHandler do
     Logger.debug("[Wire Protocol] #{service} executed #{state} in #{duration_inspect(duration)}")
   end
 
+  def handle_event([:gitrekt, :cache, :hit], _measurements, %{path: path} = _meta, _config) do
+    Logger.debug("[Cache] #{Path.basename(path)} hit")
+  end
+
+  def handle_event([:gitrekt, :cache, :miss], _measurements, %{path: path} = _meta, _config) do
+    Logger.debug("[Cache] #{Path.basename(path)} miss")
+  end
+
+  def handle_event([:gitrekt, :cache, :evict], %{count: count, bytes: bytes}, %{path: nil} = _meta, _config) do
+    Logger.debug("[Cache] evicted #{count} entries (#{bytes} bytes)")
+  end
+
+  def handle_event([:gitrekt, :cache, :evict], %{count: count, bytes: bytes}, %{path: path} = _meta, _config) do
+    Logger.debug("[Cache] #{Path.basename(path)} evicted #{count} entries (#{bytes} bytes)")
+  end
+
+  def handle_event([:gitrekt, :disk_cache, :hit], _measurements, %{path: path} = _meta, _config) do
+    Logger.debug("[Disk Cache] #{Path.basename(path)} hit")
+  end
+
+  def handle_event([:gitrekt, :disk_cache, :miss], _measurements, %{path: path} = _meta, _config) do
+    Logger.debug("[Disk Cache] #{Path.basename(path)} miss")
+  end
+
+  def handle_event([:gitrekt, :disk_cache, :load], %{count: count, bytes: bytes, duration: duration}, _meta, _config) do
+    Logger.debug("[Disk Cache] loaded #{count} entries (#{bytes} bytes) in #{duration_inspect(duration)}")
+  end
+
+  def handle_event([:gitrekt, :disk_cache, :compact], %{count: count, bytes: bytes, duration: duration}, _meta, _config) do
+    Logger.debug("[Disk Cache] compacted to #{count} entries (#{bytes} bytes reclaimed) in #{duration_inspect(duration)}")
+  end
+
+  def handle_event([:gitrekt, :refdb, :loose_refs], %{count: count}, %{path: path} = _meta, _config) do
+    Logger.debug("[Refdb] #{Path.basename(path)} has #{count} loose refs")
+  end
+
+  def handle_event([:gitrekt, :refdb, :compress], %{count: count, duration: duration}, %{path: path} = _meta, _config) do
+    Logger.debug("[Refdb] #{Path.basename(path)} packed #{count} loose refs in #{duration_inspect(duration)}")
+  end
+
+  def handle_event([:gitrekt, :library, :memory], %{total: total, peak: peak, failures: failures, repository: repository}, _meta, _config) do
+    Logger.debug("[Git Library] #{total} bytes allocated, #{repository} for the repository (peak #{peak} bytes, #{failures} failed allocations)")
+  end
+
+  def handle_event([:gitrekt, :nif, :stats], %{calls: calls, duration: duration, max_duration: max_duration, bytes: bytes}, %{name: name, arity: arity} = _meta, _config) do
+    Logger.debug("[Git NIF] #{name}/#{arity} called #{calls} times in #{duration_inspect(duration)} (max #{duration_inspect(max_duration)}, #{bytes} bytes returned)")
+  end
+
+  def handle_event([:gitrekt, :async, :stats], %{queued: queued, running: running} = measurements, _meta, _config) do
+    Logger.debug("[Git Async] #{running}/#{measurements.async_workers} workers busy, #{queued} jobs queued")
+  end
+
   #
   # Helpers
   #
@@ -0,0 +1,63 @@
+defmodule GitGud.Telemetry.GitNIFPoller do
+  @moduledoc """
+  Periodically emits the call statistics of `GitRekt.Git` NIFs as telemetry events.
+
+  Statistics are only collected when the `:nif_stats` library option is enabled (see `GitRekt.Git.library_opts_set/1`).
+  For each NIF called since the previous poll, a `[:gitrekt, :nif, :stats]` event is emitted with the number of
+  `calls`, the `duration` spent in these calls, the `max_duration` of a single call since the previous poll and
+  the `bytes` returned.
+
+  The poller resets the maximum durations on each poll (see `GitRekt.Git.geef_stats/1`), other callers should read
+  statistics without resetting them.
+
+  The state of the async worker pool is emitted as a `[:gitrekt, :async, :stats]` event on each poll.
+  """
+  use GenServer
+
+  alias GitRekt.Git
+
+  @poll_interval Application.compile_env(:gitgud, [__MODULE__, :interval], 60_000)
+
+  @doc """
+  Starts the poller as part of a supervision tree.
+  """
+  @spec start_link(keyword) :: GenServer.on_start
+  def start_link(opts \\ []) do
+    opts = Keyword.put(opts, :name, __MODULE__)
+    GenServer.start_link(__MODULE__, @poll_interval, opts)
+  end
+
+  #
+  # Callbacks
+  #
+
+  @impl true
+  def init(interval) do
+    Process.send_after(self(), :poll, interval)
+    {:ok, %{interval: interval, stats: %{}}}
+  end
+
+  @impl true
+  def handle_info(:poll, state) do
+    {:ok, stats} = Git.geef_stats(true)
+    stats = Map.new(stats, fn {name, arity, calls, total_ns, max_ns, bytes} -> {{name, arity}, {calls, total_ns, max_ns, bytes}} end)
+    Enum.each(stats, &telemetry_emit(&1, state.stats))
+    {:ok, async_stats} = Git.async_stats()
+    :telemetry.execute([:gitrekt, :async, :stats], async_stats, %{})
+    Process.send_after(self(), :poll, state.interval)
+    {:noreply, %{state|stats: stats}}
+  end
+
+  #
+  # Helpers
+  #
+
+  defp telemetry_emit({key, {calls, total_ns, max_ns, bytes}}, prev_stats) do
+    {prev_calls, prev_total_ns, _prev_max_ns, prev_bytes} = Map.get(prev_stats, key, {0, 0, 0, 0})
+    if calls > prev_calls do
+      {name, arity} = key
+      measurements = %{calls: calls - prev_calls, duration: div(total_ns - prev_total_ns, 1_000), max_duration: div(max_ns, 1_000), bytes: bytes - prev_bytes}
+      :telemetry.execute([:gitrekt, :nif, :stats], measurements, %{name: name, arity: arity})
+    end
+  end
+end
@@ -7,6 +7,7 @@ defmodule GitGud.SmartHTTPBackendTest do
   alias GitRekt.Git
   alias GitRekt.GitRepo
   alias GitRekt.GitAgent
+  alias GitRekt.GitRef
 
   alias GitGud.User
   alias GitGud.Repo
@@ -82,6 +83,25 @@ defmodule GitGud.SmartHTTPBackendTest do
     end
   end
 
+  describe "when applying reference transactions" do
+    setup :create_commit
+
+    test "creates branch and tag atomically", %{repo: repo, commit_oid: commit_oid} do
+      assert {:ok, agent} = GitRepo.get_agent(repo)
+      assert :ok = GitAgent.reference_transaction(agent, [{"refs/heads/main", nil, commit_oid}, {"refs/tags/v1.0", nil, commit_oid}])
+      assert {:ok, %GitRef{oid: ^commit_oid}} = GitAgent.reference(agent, "refs/heads/main")
+      assert {:ok, %GitRef{oid: ^commit_oid}} = GitAgent.reference(agent, "refs/tags/v1.0")
+    end
+
+    test "rejects transaction with stale reference", %{repo: repo, commit_oid: commit_oid} do
+      assert {:ok, agent} = GitRepo.get_agent(repo)
+      assert :ok = GitAgent.reference_transaction(agent, [{"refs/heads/main", nil, commit_oid}])
+      assert {:error, _reason} = GitAgent.reference_transaction(agent, [{"refs/tags/v1.0", nil, commit_oid}, {"refs/heads/main", nil, commit_oid}])
+      assert {:error, _reason} = GitAgent.reference(agent, "refs/tags/v1.0")
+      assert {:ok, %GitRef{oid: ^commit_oid}} = GitAgent.reference(agent, "refs/heads/main")
+    end
+  end
+
   describe "when repository exists" do
     setup [:start_http_backend, :clone_from_github, :create_workdir]
 
@@ -123,6 +143,19 @@ defmodule GitGud.SmartHTTPBackendTest do
     Map.put(context, :repo, repo)
   end
 
+  defp create_commit(context) do
+    {:ok, agent} = GitRepo.get_agent(context.repo)
+    sig = %{name: "testbot", email: "no-reply@git.limo", timestamp: DateTime.now!("Etc/UTC")}
+    content = "##{context.repo.name}"
+    {:ok, odb} = GitAgent.odb(agent)
+    {:ok, blob_oid} = GitAgent.odb_write(agent, odb, content, :blob)
+    {:ok, index} = GitAgent.index(agent)
+    :ok = GitAgent.index_add(agent, index, blob_oid, "README.md", byte_size(content), 0o100644)
+    {:ok, tree_oid} = GitAgent.index_write_tree(agent, index)
+    {:ok, commit_oid} = GitAgent.commit_create(agent, sig, sig, "Initial commit", tree_oid, [])
+    Map.put(context, :commit_oid, commit_oid)
+  end
+
   defp clone_from_github(context) do
     File.rm_rf!(RepoStorage.workdir(context.repo))
     {_output, 0} = System.cmd("git", ["clone", "--bare", "--quiet", "https://github.com/almightycouch/gitgud.git", context.repo.name], cd: Path.join(Keyword.fetch!(Application.get_env(:gitgud, RepoStorage), :git_root), context.user.login))
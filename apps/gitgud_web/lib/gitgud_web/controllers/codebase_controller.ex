@@ -15,6 +15,8 @@ defmodule GitGud.Web.CodebaseController do
   alias GitGud.RepoQuery
   alias GitGud.IssueQuery
 
+  @odb_batch_min_size 1_048_576
+
   plug :put_layout, :repo
   plug :ensure_authenticated when action in [:new, :create, :edit, :update, :confirm_delete, :delete]
 
@@ -53,7 +55,7 @@ defmodule GitGud.Web.CodebaseController do
     if repo = RepoQuery.user_repo(user_login, repo_name, viewer: user) do
       if authorized?(user, repo, :push) do
         with {:ok, agent} <- GitRepo.get_agent(repo),
-             {:ok, {reference, commit, tree}} <- GitAgent.transaction(agent, &resolve_tree(&1, revision, tree_path)) do
+             {:ok, {reference, commit, _tree}} <- GitAgent.transaction(agent, &resolve_tree(&1, revision, tree_path)) do
           breadcrumb = %{action: :new, cwd?: true, tree?: true}
           changeset = blob_commit_changeset(%{}, commit_params)
           if changeset.valid? do # TODO
@@ -64,7 +66,7 @@ defmodule GitGud.Web.CodebaseController do
             commit_committer_sig = commit_author_sig
             commit_message = commit_changeset_message(changeset)
             commit_update_ref = commit_changeset_update_ref(changeset)
-            with {:ok, {reference_oid, commit_oid}} <-GitAgent.transaction(agent, &write_blob_new(&1, commit, tree, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message)),
+            with {:ok, {reference_oid, commit_oid}} <-GitAgent.transaction(agent, &write_blob_new(&1, commit, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message)),
                  {:ok, repo} <- GitRepo.push(repo, [{:update, reference_oid, commit_oid, commit_update_ref}]) do
               conn
               |> put_flash(:info, "File #{blob_name} created.")
@@ -373,9 +375,12 @@ defmodule GitGud.Web.CodebaseController do
   end
 
   defp resolve_revisions_graph(agent, head, revs) do
-    GitAgent.transaction(agent, fn agent ->
-      Enum.reduce_while(Enum.reverse(revs), {:ok, []}, &resolve_revision_graph(agent, head, &1, &2))
-    end)
+    case GitAgent.graph_ahead_behind_many(agent, head.oid, Enum.map(revs, fn {rev, _author, _timestamp} -> rev.oid end)) do
+      {:ok, graph_diffs} ->
+        {:ok, Enum.map(Enum.zip(revs, graph_diffs), fn {{rev, author, timestamp}, graph_diff} -> {rev, author, timestamp, graph_diff} end)}
+      {:error, reason} ->
+        {:error, reason}
+    end
   end
 
   defp resolve_revisions_db(revs) do
@@ -405,15 +410,6 @@ defmodule GitGud.Web.CodebaseController do
     end
   end
 
-  defp resolve_revision_graph(agent, head, {rev, author, timestamp}, {:ok, acc}) do
-    case GitAgent.graph_ahead_behind(agent, rev.oid, head.oid) do
-      {:ok, graph_diff} ->
-        {:cont, {:ok, [{rev, author, timestamp, graph_diff}|acc]}}
-      {:error, reason} ->
-        {:halt, {:error, reason}}
-    end
-  end
-
   defp resolve_tree(agent, revision, []) do
     with {:ok, {object, reference}} <- GitAgent.revision(agent, revision),
          {:ok, commit} <- GitAgent.peel(agent, object, target: :commit),
@@ -468,46 +464,41 @@ defmodule GitGud.Web.CodebaseController do
   end
 
   defp write_blob(agent, commit, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message) do
-    with {:ok, tree} <- GitAgent.tree(agent, commit),
-         {:ok, index} <- GitAgent.index(agent),
-          :ok <- GitAgent.index_read_tree(agent, index, tree),
-         {:ok, odb} <- GitAgent.odb(agent),
-         {:ok, blob_oid} <- GitAgent.odb_write(agent, odb, blob_content, :blob),
-          :ok <- GitAgent.index_add(agent, index, blob_oid, Path.join(blob_path), byte_size(blob_content), 0o100644),
-         {:ok, tree_oid} <- GitAgent.index_write_tree(agent, index),
-         {:ok, reference} <- GitAgent.reference(agent, commit_update_ref),
-         {:ok, commit_oid} <- GitAgent.commit_create(agent, commit_author_sig, commit_committer_sig, commit_message, tree_oid, [commit.oid], update_ref: commit_update_ref) do
-      {:ok, {reference.oid, commit_oid}}
-    end
+    batch? = byte_size(blob_content) >= @odb_batch_min_size
+    write_commit(agent, commit, &write_blob_updates(&1, blob_path, blob_content), batch?, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message)
   end
 
-  defp write_blob_new(agent, commit, tree, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message) do
-    case GitAgent.tree_entry_by_path(agent, tree, Path.join(blob_path)) do
+  defp write_blob_new(agent, commit, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message) do
+    case GitAgent.tree_entry_by_path(agent, commit, Path.join(blob_path)) do
       {:ok, tree_entry} ->
         {:error, {:already_exist, tree_entry}}
       {:error, _reason} ->
-        with {:ok, index} <- GitAgent.index(agent),
-              :ok <- GitAgent.index_read_tree(agent, index, tree),
-             {:ok, odb} <- GitAgent.odb(agent),
-             {:ok, blob_oid} <- GitAgent.odb_write(agent, odb, blob_content, :blob),
-              :ok <- GitAgent.index_add(agent, index, blob_oid, Path.join(blob_path), byte_size(blob_content), 0o100644),
-             {:ok, tree_oid} <- GitAgent.index_write_tree(agent, index),
-             {:ok, reference} <- GitAgent.reference(agent, commit_update_ref),
-             {:ok, commit_oid} <- GitAgent.commit_create(agent, commit_author_sig, commit_committer_sig, commit_message, tree_oid, [commit.oid], update_ref: commit_update_ref) do
-          {:ok, {reference.oid, commit_oid}}
-        end
+        write_blob(agent, commit, blob_path, blob_content, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message)
     end
   end
 
+  defp write_blob_updates(batch, blob_path, blob_content) do
+    with {:ok, odb} <- GitAgent.odb(batch),
+         {:ok, blob_oid} <- GitAgent.odb_write(batch, odb, blob_content, :blob), do:
+      {:ok, [{:upsert, Path.join(blob_path), blob_oid, 0o100644}]}
+  end
+
   defp delete_blob(agent, commit, blob_path, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message) do
-    with {:ok, tree} <- GitAgent.tree(agent, commit),
-         {:ok, index} <- GitAgent.index(agent),
-          :ok <- GitAgent.index_read_tree(agent, index, tree),
-          :ok <- GitAgent.index_remove(agent, index, Path.join(blob_path)),
-         {:ok, tree_oid} <- GitAgent.index_write_tree(agent, index),
-         {:ok, reference} <- GitAgent.reference(agent, commit_update_ref),
-         {:ok, commit_oid} <- GitAgent.commit_create(agent, commit_author_sig, commit_committer_sig, commit_message, tree_oid, [commit.oid], update_ref: commit_update_ref) do
+    write_commit(agent, commit, fn _batch -> {:ok, [{:remove, Path.join(blob_path)}]} end, false, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message)
+  end
+
+  defp write_commit(agent, commit, tree_updates_cb, batch?, commit_update_ref, commit_author_sig, commit_committer_sig, commit_message) do
+    write_objects = &write_commit_batch(&1, commit, tree_updates_cb, commit_author_sig, commit_committer_sig, commit_message)
+    with {:ok, reference} <- GitAgent.reference(agent, commit_update_ref),
+         {:ok, commit_oid} <- (if batch?, do: GitAgent.odb_batch(agent, write_objects), else: write_objects.(agent)),
+          :ok <- GitAgent.reference_transaction(agent, [{commit_update_ref, reference.oid, commit_oid}]) do
       {:ok, {reference.oid, commit_oid}}
     end
   end
+
+  defp write_commit_batch(batch, commit, tree_updates_cb, commit_author_sig, commit_committer_sig, commit_message) do
+    with {:ok, tree_updates} <- tree_updates_cb.(batch),
+         {:ok, tree_oid} <- GitAgent.tree_update(batch, commit, tree_updates), do:
+      GitAgent.commit_create(batch, commit_author_sig, commit_committer_sig, commit_message, tree_oid, [commit.oid])
+  end
 end
@@ -7,6 +7,7 @@ defmodule GitGud.Web.CommitDiffLive do
 
   alias GitRekt.GitRepo
   alias GitRekt.GitAgent
+  alias GitRekt.DiffCache
 
   alias GitGud.DB
   alias GitGud.DBQueryable
@@ -29,6 +30,11 @@ defmodule GitGud.Web.CommitDiffLive do
 
   import GitGud.Web.CodebaseView
 
+  @diff_deltas_page_size 50
+  @diff_max_file_lines 2_000
+  @diff_max_lines 20_000
+  @diff_max_file_size 1_048_576
+
   #
   # Callbacks
   #
@@ -124,6 +130,16 @@ defmodule GitGud.Web.CommitDiffLive do
     {:noreply, push_event(socket, "delete_review_form", %{oid: oid, hunk: hunk, line: line})}
   end
 
+  def handle_event("load_more_deltas", _params, socket) do
+    {
+      :noreply,
+      socket
+      |> assign_more_diff_deltas!()
+      |> assign_reviews()
+      |> assign_users_typing()
+    }
+  end
+
   def handle_event("reset_review_form", %{"review_id" => review_id}, socket) do
     send_update(GitGud.Web.CommentFormLive, id: "review-#{review_id}-comment-form", minimized: true, changeset: Comment.changeset(%Comment{}))
     {:noreply, assign_presence_typing!(socket, String.to_integer(review_id), false)}
@@ -196,9 +212,21 @@ defmodule GitGud.Web.CommitDiffLive do
   defp assign_diff!(socket, oid) do
     assigns = resolve_commit_diff!(socket.assigns.agent, oid)
     assigns = Map.update!(assigns, :commit_info, &resolve_db_commit_info/1)
+    assigns = Map.merge(assigns, %{diff_iter: nil, diff_deltas_by_path: map_diff_deltas_by_path(assigns.diff_deltas)})
     assign(socket, assigns)
   end
 
+  defp assign_more_diff_deltas!(socket) do
+    case GitAgent.transaction(socket.assigns.agent, &resolve_diff_deltas(&1, socket.assigns)) do
+      {:ok, {diff_iter, diff_deltas}} ->
+        socket
+        |> assign(diff_iter: diff_iter, diff_deltas: socket.assigns.diff_deltas ++ diff_deltas)
+        |> assign(:diff_deltas_by_path, Map.merge(socket.assigns.diff_deltas_by_path, map_diff_deltas_by_path(diff_deltas)))
+      {:error, error} ->
+        raise error
+    end
+  end
+
   defp assign_reviews(socket) do
     assign(socket, :reviews, ReviewQuery.commit_line_reviews(socket.assigns.repo, socket.assigns.commit.oid, preload: {:comments, :author}))
   end
@@ -267,8 +295,8 @@ defmodule GitGud.Web.CommitDiffLive do
 
   defp resolve_commit_diff!(agent, oid) do
     case GitAgent.transaction(agent, &resolve_commit_diff(&1, oid)) do
-      {:ok, {commit, commit_info, diff_stats, diff_deltas}} ->
-        %{commit: commit, commit_info: commit_info, diff_stats: diff_stats, diff_deltas: diff_deltas}
+      {:ok, {commit, commit_info, diff_stats, diff_file_stats, diff_deltas}} ->
+        %{commit: commit, commit_info: commit_info, diff_stats: diff_stats, diff_file_stats: diff_file_stats, diff_deltas: diff_deltas}
       {:error, error} ->
         raise error
     end
@@ -277,13 +305,60 @@ defmodule GitGud.Web.CommitDiffLive do
   defp resolve_commit_diff(agent, oid) do
     with {:ok, commit} <- GitAgent.object(agent, oid),
          {:ok, commit_info} <- resolve_commit_info(agent, commit),
-         {:ok, diff} <- GitAgent.diff(agent, Enum.at(commit_info.parents, 0), commit),
-         {:ok, diff_stats} <- GitAgent.diff_stats(agent, diff),
-         {:ok, diff_deltas} <- GitAgent.diff_deltas(agent, diff) do
-      {:ok, {commit, commit_info, diff_stats, diff_deltas}}
+         {:ok, {diff_stats, diff_file_stats, diff_deltas}} <- resolve_diff(agent, Enum.at(commit_info.parents, 0), commit) do
+      {:ok, {commit, commit_info, diff_stats, diff_file_stats, diff_deltas}}
+    end
+  end
+
+  defp resolve_diff(agent, parent, commit) do
+    with {:ok, cache_key} <- resolve_diff_cache_key(agent, parent, commit, diff_deltas_opts(0)) do
+      DiffCache.fetch_or_compute(agent, cache_key, fn agent ->
+        with {:ok, diff} <- GitAgent.diff(agent, parent, commit, find_renames: true),
+             {:ok, diff_stats} <- GitAgent.diff_stats(agent, diff),
+             {:ok, diff_file_stats} <- GitAgent.diff_file_stats(agent, diff),
+             {:ok, diff_deltas} <- GitAgent.diff_deltas(agent, diff, diff_deltas_opts(0)) do
+          {:ok, {diff_stats, diff_file_stats, diff_deltas}}
+        end
+      end)
+    end
+  end
+
+  defp resolve_diff_deltas(agent, %{diff_iter: nil} = assigns) do
+    offset = Enum.count(assigns.diff_deltas)
+    lines = Enum.sum(Enum.map(assigns.diff_deltas, &count_diff_delta_lines/1))
+    with {:ok, diff} <- GitAgent.diff(agent, Enum.at(assigns.commit_info.parents, 0), assigns.commit, find_renames: true),
+         {:ok, diff_iter} <- GitAgent.diff_deltas_iterator(agent, diff, [lines: lines] ++ diff_deltas_opts(offset)) do
+      resolve_diff_deltas(agent, %{assigns|diff_iter: diff_iter})
+    end
+  end
+
+  defp resolve_diff_deltas(agent, %{diff_iter: diff_iter}) do
+    case GitAgent.diff_deltas(agent, diff_iter, limit: @diff_deltas_page_size) do
+      {:ok, diff_deltas} ->
+        {:ok, {diff_iter, diff_deltas}}
+      {:error, reason} ->
+        {:error, reason}
     end
   end
 
+  defp map_diff_deltas_by_path(diff_deltas), do: Map.new(diff_deltas, &{&1.new_file.path, &1})
+
+  defp count_diff_delta_lines(delta) do
+    Enum.sum(Enum.map(delta.hunks, fn hunk -> Enum.count(hunk.lines, &(&1.origin in [" ", "+", "-"])) end))
+  end
+
+  defp resolve_diff_cache_key(agent, parent, commit, opts) do
+    with {:ok, old_tree} <- resolve_parent_tree(agent, parent),
+         {:ok, new_tree} <- GitAgent.tree(agent, commit) do
+      {:ok, DiffCache.key(old_tree && old_tree.oid, new_tree.oid, [find_renames: true] ++ opts)}
+    end
+  end
+
+  defp resolve_parent_tree(_agent, nil), do: {:ok, nil}
+  defp resolve_parent_tree(agent, parent), do: GitAgent.tree(agent, parent)
+
+  defp diff_deltas_opts(offset), do: [offset: offset, limit: @diff_deltas_page_size, max_file_lines: @diff_max_file_lines, max_lines: @diff_max_lines, max_file_size: @diff_max_file_size]
+
   defp resolve_commit_info(agent, commit) do
     with {:ok, timestamp} <- GitAgent.commit_timestamp(agent, commit),
          {:ok, message} <- GitAgent.commit_message(agent, commit),
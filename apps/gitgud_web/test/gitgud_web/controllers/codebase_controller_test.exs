@@ -0,0 +1,75 @@
+defmodule GitGud.Web.CodebaseControllerTest do
+  use GitGud.Web.ConnCase, async: true
+  use GitGud.Web.DataFactory
+
+  alias GitRekt.GitRepo
+  alias GitRekt.GitAgent
+
+  alias GitGud.User
+  alias GitGud.Repo
+  alias GitGud.RepoStorage
+  alias GitGud.Email
+
+  setup [:create_user, :create_repo, :create_commit]
+
+  test "creates file in sub-directory", %{conn: conn, user: user, repo: repo} do
+    commit_params = %{name: "bar.ex", content: "defmodule Bar, do: nil\n", message: "Add bar.ex", branch: "main"}
+    conn = Plug.Test.init_test_session(conn, user_id: user.id)
+    conn = post(conn, Routes.codebase_path(conn, :create, user, repo, "main", ["lib"]), commit: commit_params)
+    assert get_flash(conn, :info) == "File bar.ex created."
+    assert redirected_to(conn) == Routes.codebase_path(conn, :blob, user, repo, "main", ["lib", "bar.ex"])
+    assert {:ok, agent} = GitRepo.get_agent(repo)
+    assert {:ok, head} = GitAgent.reference(agent, "refs/heads/main")
+    assert {:ok, commit} = GitAgent.peel(agent, head)
+    assert {:ok, "Add bar.ex"} = GitAgent.commit_message(agent, commit)
+    assert {:ok, _tree_entry} = GitAgent.tree_entry_by_path(agent, commit, "README.md")
+    assert {:ok, _tree_entry} = GitAgent.tree_entry_by_path(agent, commit, "lib/foo.ex")
+    assert {:ok, tree_entry} = GitAgent.tree_entry_by_path(agent, commit, "lib/bar.ex")
+    assert {:ok, blob} = GitAgent.peel(agent, tree_entry)
+    assert {:ok, "defmodule Bar, do: nil\n"} = GitAgent.blob_content(agent, blob)
+    assert {:error, _reason} = GitAgent.tree_entry_by_path(agent, commit, "lib/lib/bar.ex")
+  end
+
+  test "fails to create existing file in sub-directory", %{conn: conn, user: user, repo: repo} do
+    commit_params = %{name: "foo.ex", content: "defmodule Foo, do: nil\n", message: "Add foo.ex", branch: "main"}
+    conn = Plug.Test.init_test_session(conn, user_id: user.id)
+    conn = post(conn, Routes.codebase_path(conn, :create, user, repo, "main", ["lib"]), commit: commit_params)
+    assert get_flash(conn, :error) == "Something went wrong! Please check error(s) below."
+    assert html_response(conn, 400)
+  end
+
+  #
+  # Helpers
+  #
+
+  defp create_user(context) do
+    user = User.create!(factory(:user))
+    on_exit fn ->
+      File.rmdir(Path.join(Keyword.fetch!(Application.get_env(:gitgud, RepoStorage), :git_root), user.login))
+    end
+    Map.put(context, :user, struct(user, emails: Enum.map(user.emails, &Email.verify!/1)))
+  end
+
+  defp create_repo(context) do
+    repo = Repo.create!(context.user, factory(:repo))
+    on_exit fn ->
+      File.rm_rf(RepoStorage.workdir(repo))
+    end
+    Map.put(context, :repo, repo)
+  end
+
+  defp create_commit(context) do
+    workdir = Path.join(System.tmp_dir!(), "gitgud-codebase-#{context.repo.id}")
+    File.mkdir_p!(Path.join(workdir, "lib"))
+    on_exit fn ->
+      File.rm_rf(workdir)
+    end
+    File.write!(Path.join(workdir, "README.md"), "# #{context.repo.name}\n")
+    File.write!(Path.join([workdir, "lib", "foo.ex"]), "defmodule Foo, do: nil\n")
+    {_output, 0} = System.cmd("git", ["init", "-b", "main"], cd: workdir)
+    {_output, 0} = System.cmd("git", ["add", "README.md", "lib/foo.ex"], cd: workdir)
+    {_output, 0} = System.cmd("git", ["-c", "user.name=testbot", "-c", "user.email=no-reply@git.limo", "commit", "-m", "Initial commit"], cd: workdir)
+    {_output, 0} = System.cmd("git", ["push", "--quiet", RepoStorage.workdir(context.repo), "main"], cd: workdir, stderr_to_stdout: true)
+    context
+  end
+end
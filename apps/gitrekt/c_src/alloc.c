@@ -0,0 +1,365 @@
+#include "erl_nif.h"
+#include "geef.h"
+#include "alloc.h"
+#include "repository.h"
+#include "revwalk.h"
+#include <stdint.h>
+#include <string.h>
+#include <git2.h>
+#include <git2/sys/alloc.h>
+
+/*
+ * libgit2 allocates through enif_alloc() so that its memory shows up in
+ * erlang:memory(system). Each block is prefixed with a header recording its
+ * size and category, the category being derived from the libgit2 source file
+ * requesting the allocation.
+ *
+ * When a soft limit is set, allocations made while building or indexing packs
+ * fail with GIT_ERROR_NOMEMORY once the total goes above the limit. Other
+ * categories are not limited: failing a lookup or a diff half-way leaves
+ * libgit2 caches and iterators in states callers do not expect, whereas pack
+ * building is the one operation whose memory grows with client input.
+ *
+ * Allocations are also attributed to a repository: each NIF called with a
+ * repository (or a revision walk, for pack building) as first argument sets it
+ * as the owner of the calling thread until it returns (see geef_alloc_enter()).
+ * Blocks keep a reference to their owner, so that they are accounted for until
+ * freed, even once the repository itself is gone.
+ */
+
+typedef enum {
+	GEEF_ALLOC_PACK,
+	GEEF_ALLOC_ODB,
+	GEEF_ALLOC_CACHE,
+	GEEF_ALLOC_REFS,
+	GEEF_ALLOC_DIFF,
+	GEEF_ALLOC_OTHER,
+	GEEF_ALLOC_CATEGORIES
+} geef_alloc_category;
+
+static const char *alloc_category_names[GEEF_ALLOC_CATEGORIES] = {
+	"pack", "odb", "cache", "refs", "diff", "other"
+};
+
+struct geef_alloc_owner {
+	size_t bytes;
+	unsigned int refs;
+};
+
+typedef union {
+	struct {
+		size_t size;
+		geef_alloc_category category;
+		geef_alloc_owner *owner;
+	} h;
+	/* keep the user block aligned like malloc() would */
+	long double align;
+} alloc_header;
+
+static size_t alloc_bytes[GEEF_ALLOC_CATEGORIES];
+static size_t alloc_total;
+static size_t alloc_peak;
+static size_t alloc_failures;
+static size_t alloc_soft_limit;
+static __thread geef_alloc_owner *alloc_current;
+
+static geef_alloc_owner *alloc_owner_keep(geef_alloc_owner *owner)
+{
+	if (owner)
+		__atomic_add_fetch(&owner->refs, 1, __ATOMIC_RELAXED);
+	return owner;
+}
+
+void geef_alloc_owner_release(geef_alloc_owner *owner)
+{
+	if (owner && __atomic_sub_fetch(&owner->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		enif_free(owner);
+}
+
+/* the owner is created on first use, repositories being opened from many places */
+static geef_alloc_owner *alloc_repository_owner(geef_repository *repo)
+{
+	geef_alloc_owner *owner, *expected = NULL;
+
+	owner = __atomic_load_n(&repo->alloc_owner, __ATOMIC_ACQUIRE);
+	if (owner)
+		return owner;
+
+	/* allocated outside of the tracking allocator, its own memory is not attributed to anyone */
+	owner = enif_alloc(sizeof(geef_alloc_owner));
+	if (owner == NULL)
+		return NULL;
+
+	owner->bytes = 0;
+	owner->refs = 1;
+	if (!__atomic_compare_exchange_n(&repo->alloc_owner, &expected, owner, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		enif_free(owner);
+		return expected;
+	}
+
+	return owner;
+}
+
+geef_alloc_owner *geef_alloc_enter(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_alloc_owner *prev = alloc_current;
+	geef_repository *repo;
+	geef_revwalk *walk;
+
+	if (argc > 0 && enif_get_resource(env, argv[0], geef_repository_type, (void **)&repo))
+		alloc_current = alloc_repository_owner(repo);
+	else if (argc > 0 && enif_get_resource(env, argv[0], geef_revwalk_type, (void **)&walk))
+		alloc_current = alloc_repository_owner(walk->repo);
+
+	return prev;
+}
+
+void geef_alloc_leave(geef_alloc_owner *prev)
+{
+	alloc_current = prev;
+}
+
+static geef_alloc_category alloc_category(const char *file)
+{
+	const char *name;
+
+	if (file == NULL)
+		return GEEF_ALLOC_OTHER;
+
+	if (strstr(file, "xdiff") != NULL)
+		return GEEF_ALLOC_DIFF;
+
+	name = strrchr(file, '/');
+	name = name ? name + 1 : file;
+
+	if (!strncmp(name, "pack-objects", 12) || !strncmp(name, "indexer", 7) || !strncmp(name, "delta", 5))
+		return GEEF_ALLOC_PACK;
+	if (!strncmp(name, "odb", 3) || !strncmp(name, "pack", 4) || !strncmp(name, "mwindow", 7) || !strncmp(name, "zstream", 7) || !strncmp(name, "midx", 4))
+		return GEEF_ALLOC_ODB;
+	if (!strncmp(name, "cache", 5) || !strncmp(name, "oidmap", 6) || !strncmp(name, "offmap", 6))
+		return GEEF_ALLOC_CACHE;
+	if (!strncmp(name, "refdb", 5) || !strncmp(name, "refs", 4) || !strncmp(name, "reflog", 6) || !strncmp(name, "transaction", 11))
+		return GEEF_ALLOC_REFS;
+	if (!strncmp(name, "diff", 4) || !strncmp(name, "patch", 5))
+		return GEEF_ALLOC_DIFF;
+
+	return GEEF_ALLOC_OTHER;
+}
+
+static void alloc_account(geef_alloc_category category, geef_alloc_owner *owner, size_t added, size_t removed)
+{
+	size_t total, peak;
+
+	if (owner && added)
+		__atomic_add_fetch(&owner->bytes, added, __ATOMIC_RELAXED);
+	if (owner && removed)
+		__atomic_sub_fetch(&owner->bytes, removed, __ATOMIC_RELAXED);
+
+	if (added) {
+		__atomic_add_fetch(&alloc_bytes[category], added, __ATOMIC_RELAXED);
+		total = __atomic_add_fetch(&alloc_total, added, __ATOMIC_RELAXED);
+		peak = __atomic_load_n(&alloc_peak, __ATOMIC_RELAXED);
+		while (total > peak && !__atomic_compare_exchange_n(&alloc_peak, &peak, total, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	}
+
+	if (removed) {
+		__atomic_sub_fetch(&alloc_bytes[category], removed, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&alloc_total, removed, __ATOMIC_RELAXED);
+	}
+}
+
+static int alloc_over_limit(geef_alloc_category category, size_t n)
+{
+	size_t limit = __atomic_load_n(&alloc_soft_limit, __ATOMIC_RELAXED);
+
+	if (limit == 0 || category != GEEF_ALLOC_PACK)
+		return 0;
+
+	if (__atomic_load_n(&alloc_total, __ATOMIC_RELAXED) + n <= limit)
+		return 0;
+
+	__atomic_add_fetch(&alloc_failures, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+static void *geef_malloc(size_t n, const char *file, int line)
+{
+	geef_alloc_category category = alloc_category(file);
+	alloc_header *header;
+
+	if (n > SIZE_MAX - sizeof(alloc_header) || alloc_over_limit(category, n))
+		return NULL;
+
+	if ((header = enif_alloc(sizeof(alloc_header) + n)) == NULL)
+		return NULL;
+
+	header->h.size = n;
+	header->h.category = category;
+	header->h.owner = alloc_owner_keep(alloc_current);
+	alloc_account(category, header->h.owner, n, 0);
+
+	return header + 1;
+}
+
+static void *geef_realloc(void *ptr, size_t size, const char *file, int line)
+{
+	alloc_header *header, *new_header;
+	size_t old_size;
+
+	if (ptr == NULL)
+		return geef_malloc(size, file, line);
+
+	header = (alloc_header *)ptr - 1;
+	old_size = header->h.size;
+
+	if (size > SIZE_MAX - sizeof(alloc_header))
+		return NULL;
+
+	if (size > old_size && alloc_over_limit(header->h.category, size - old_size))
+		return NULL;
+
+	if ((new_header = enif_realloc(header, sizeof(alloc_header) + size)) == NULL)
+		return NULL;
+
+	new_header->h.size = size;
+	alloc_account(new_header->h.category, new_header->h.owner, size, old_size);
+
+	return new_header + 1;
+}
+
+static void geef_free(void *ptr)
+{
+	alloc_header *header;
+
+	if (ptr == NULL)
+		return;
+
+	header = (alloc_header *)ptr - 1;
+	alloc_account(header->h.category, header->h.owner, 0, header->h.size);
+	geef_alloc_owner_release(header->h.owner);
+	enif_free(header);
+}
+
+#if !GEEF_LIBGIT2_VERSION_CHECK(1, 4)
+static void *geef_calloc(size_t nelem, size_t elsize, const char *file, int line)
+{
+	void *ptr;
+	size_t n;
+
+	if (__builtin_mul_overflow(nelem, elsize, &n))
+		return NULL;
+
+	if ((ptr = geef_malloc(n, file, line)) != NULL)
+		memset(ptr, 0, n);
+
+	return ptr;
+}
+
+static char *geef_substrdup(const char *str, size_t n, const char *file, int line)
+{
+	char *ptr;
+
+	if (n == SIZE_MAX || (ptr = geef_malloc(n + 1, file, line)) == NULL)
+		return NULL;
+
+	memcpy(ptr, str, n);
+	ptr[n] = '\0';
+
+	return ptr;
+}
+
+static char *geef_strdup(const char *str, const char *file, int line)
+{
+	return geef_substrdup(str, strlen(str), file, line);
+}
+
+static char *geef_strndup(const char *str, size_t n, const char *file, int line)
+{
+	size_t len = strnlen(str, n);
+
+	return geef_substrdup(str, len, file, line);
+}
+
+static void *geef_reallocarray(void *ptr, size_t nelem, size_t elsize, const char *file, int line)
+{
+	size_t n;
+
+	if (__builtin_mul_overflow(nelem, elsize, &n))
+		return NULL;
+
+	return geef_realloc(ptr, n, file, line);
+}
+
+static void *geef_mallocarray(size_t nelem, size_t elsize, const char *file, int line)
+{
+	return geef_reallocarray(NULL, nelem, elsize, file, line);
+}
+#endif
+
+static git_allocator geef_allocator = {
+	geef_malloc,
+#if !GEEF_LIBGIT2_VERSION_CHECK(1, 4)
+	geef_calloc,
+	geef_strdup,
+	geef_strndup,
+	geef_substrdup,
+	geef_realloc,
+	geef_reallocarray,
+	geef_mallocarray,
+#else
+	geef_realloc,
+#endif
+	geef_free
+};
+
+/* Must run before git_libgit2_init(), so that every block libgit2 frees has been allocated here. */
+int geef_alloc_init(void)
+{
+	return git_libgit2_opts(GIT_OPT_SET_ALLOCATOR, &geef_allocator);
+}
+
+void geef_alloc_set_soft_limit(size_t limit)
+{
+	__atomic_store_n(&alloc_soft_limit, limit, __ATOMIC_RELAXED);
+}
+
+size_t geef_alloc_soft_limit(void)
+{
+	return __atomic_load_n(&alloc_soft_limit, __ATOMIC_RELAXED);
+}
+
+ERL_NIF_TERM
+geef_library_memory_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ERL_NIF_TERM stats, categories;
+	size_t i;
+
+	categories = enif_make_new_map(env);
+	for (i = 0; i < GEEF_ALLOC_CATEGORIES; i++) {
+		size_t bytes = __atomic_load_n(&alloc_bytes[i], __ATOMIC_RELAXED);
+		enif_make_map_put(env, categories, enif_make_atom(env, alloc_category_names[i]), enif_make_uint64(env, bytes), &categories);
+	}
+
+	stats = enif_make_new_map(env);
+	enif_make_map_put(env, stats, atoms.memory_total, enif_make_uint64(env, __atomic_load_n(&alloc_total, __ATOMIC_RELAXED)), &stats);
+	enif_make_map_put(env, stats, atoms.memory_peak, enif_make_uint64(env, __atomic_load_n(&alloc_peak, __ATOMIC_RELAXED)), &stats);
+	enif_make_map_put(env, stats, atoms.memory_failures, enif_make_uint64(env, __atomic_load_n(&alloc_failures, __ATOMIC_RELAXED)), &stats);
+	enif_make_map_put(env, stats, atoms.library_memory_soft_limit, enif_make_uint64(env, geef_alloc_soft_limit()), &stats);
+	enif_make_map_put(env, stats, atoms.memory_categories, categories, &stats);
+
+	return enif_make_tuple2(env, atoms.ok, stats);
+}
+
+ERL_NIF_TERM
+geef_repository_memory(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_repository *repo;
+	geef_alloc_owner *owner;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **)&repo))
+		return enif_make_badarg(env);
+
+	owner = __atomic_load_n(&repo->alloc_owner, __ATOMIC_ACQUIRE);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_uint64(env, owner ? __atomic_load_n(&owner->bytes, __ATOMIC_RELAXED) : 0));
+}
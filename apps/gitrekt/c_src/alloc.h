@@ -0,0 +1,19 @@
+#ifndef GEEF_ALLOC_H
+#define GEEF_ALLOC_H
+
+#include <stddef.h>
+
+typedef struct geef_alloc_owner geef_alloc_owner;
+
+int geef_alloc_init(void);
+void geef_alloc_set_soft_limit(size_t limit);
+size_t geef_alloc_soft_limit(void);
+
+geef_alloc_owner *geef_alloc_enter(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+void geef_alloc_leave(geef_alloc_owner *prev);
+void geef_alloc_owner_release(geef_alloc_owner *owner);
+
+ERL_NIF_TERM geef_library_memory_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_repository_memory(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif
@@ -24,6 +24,7 @@ geef_commit_parent(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	int error;
 	ErlNifBinary bin;
 	geef_object *obj, *parent;
+	git_commit *commit;
 	ERL_NIF_TERM term_parent;
 	unsigned int nth;
 
@@ -33,21 +34,24 @@ geef_commit_parent(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (!enif_get_uint(env, argv[1], &nth))
 		return enif_make_badarg(env);
 
-	parent = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-
-	error = git_commit_parent((git_commit **) &parent->obj, (git_commit *) obj->obj, nth);
+	error = git_commit_parent(&commit, (git_commit *) obj->obj, nth);
 	if (error < 0)
 		return geef_error_struct(env, error);
 
+	parent = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!parent) {
+		git_commit_free(commit);
+		return geef_oom(env);
+	}
+
+	geef_object_intern(parent, obj->repo, (git_object *) commit);
+
 	term_parent = enif_make_resource(env, parent);
 	enif_release_resource(parent);
 
 	if (geef_oid_bin(&bin, git_object_id(parent->obj)) < 0)
 		return geef_oom(env);
 
-	parent->repo = obj->repo;
-	enif_keep_resource(parent->repo);
-
 	return enif_make_tuple3(env, atoms.ok, enif_make_binary(env, &bin), term_parent);
 }
 
@@ -75,26 +79,30 @@ geef_commit_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	int error;
 	ErlNifBinary bin;
 	geef_object *obj, *tree;
+	git_tree *commit_tree;
 	ERL_NIF_TERM term_tree;
 
 	if (!enif_get_resource(env, argv[0], geef_object_type, (void **) &obj))
 		return enif_make_badarg(env);
 
-	tree = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-
-	error = git_commit_tree((git_tree **) &tree->obj, (git_commit *) obj->obj);
+	error = git_commit_tree(&commit_tree, (git_commit *) obj->obj);
 	if (error < 0)
 		return geef_error_struct(env, error);
 
+	tree = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!tree) {
+		git_tree_free(commit_tree);
+		return geef_oom(env);
+	}
+
+	geef_object_intern(tree, obj->repo, (git_object *) commit_tree);
+
 	term_tree = enif_make_resource(env, tree);
 	enif_release_resource(tree);
 
 	if (geef_oid_bin(&bin, git_object_id(tree->obj)) < 0)
 		return geef_oom(env);
 
-	tree->repo = obj->repo;
-	enif_keep_resource(tree->repo);
-
 	return enif_make_tuple3(env, atoms.ok, enif_make_binary(env, &bin), term_tree);
 }
 
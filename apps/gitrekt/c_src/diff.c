@@ -6,22 +6,14 @@
 #include "oid.h"
 #include "diff.h"
 
-typedef struct {
-	ERL_NIF_TERM hunk;
-	ERL_NIF_TERM lines;
-} diff_hunk;
-
-typedef struct {
-	ERL_NIF_TERM delta;
-	diff_hunk **hunks;
-	size_t size;
-} diff_delta;
+#define DIFF_RENAME_LIMIT 1000
 
 typedef struct {
-	ErlNifEnv *env;
-	diff_delta **deltas;
+	const git_blob *blob;
+	ERL_NIF_TERM term;
+	const char *data;
 	size_t size;
-} diff_pack;
+} diff_blob_bin;
 
 static git_diff_format_t diff_format_atom2type(ERL_NIF_TERM term)
 {
@@ -42,8 +34,8 @@ static git_diff_format_t diff_format_atom2type(ERL_NIF_TERM term)
 static git_diff_options diff_opts_atom2type(ErlNifEnv *env, ERL_NIF_TERM keyword)
 {
 	ERL_NIF_TERM head, tail, key, val;
-	unsigned int size;
-    int arity;
+	unsigned int size, uval;
+	int arity;
 	size_t i;
 	const ERL_NIF_TERM *array;
 	git_diff_options opts;
@@ -68,10 +60,10 @@ static git_diff_options diff_opts_atom2type(ErlNifEnv *env, ERL_NIF_TERM keyword
 		key = array[0];
 		val = array[1];
 
-		if (!enif_compare(key, atoms.diff_opts_context_lines))
-			opts.context_lines = val;
-		else if (!enif_compare(key, atoms.diff_opts_interhunk_lines))
-			opts.interhunk_lines = val;
+		if (!enif_compare(key, atoms.diff_opts_context_lines) && enif_get_uint(env, val, &uval))
+			opts.context_lines = uval;
+		else if (!enif_compare(key, atoms.diff_opts_interhunk_lines) && enif_get_uint(env, val, &uval))
+			opts.interhunk_lines = uval;
 		else if (!enif_compare(key, atoms.diff_opts_pathspec)) {
 			opts.pathspec = git_strarray_from_list(env, val);
 		}
@@ -80,34 +72,133 @@ static git_diff_options diff_opts_atom2type(ErlNifEnv *env, ERL_NIF_TERM keyword
 	return opts;
 }
 
-static ERL_NIF_TERM diff_file_to_term(ErlNifEnv *env, const git_diff_file *file)
+static git_diff_find_options diff_find_opts_atom2type(ErlNifEnv *env, ERL_NIF_TERM keyword)
 {
-	ErlNifBinary path, oid;
+	ERL_NIF_TERM head, tail, key, val;
+	unsigned int size, uval;
+	int arity;
+	size_t i;
+	const ERL_NIF_TERM *array;
+	git_diff_find_options opts;
 
-	if (geef_oid_bin(&oid, &file->id) < 0)
-		return geef_oom(env);
+	git_diff_find_init_options(&opts, GIT_DIFF_FIND_OPTIONS_VERSION);
+	opts.flags = 0;
 
-	if (geef_string_to_bin(&path, file->path) < 0) {
-		enif_release_binary(&path);
-		return geef_oom(env);
+	if (!enif_get_list_length(env, keyword, &size))
+		return opts;
+
+	tail = keyword;
+	for(i = 0; i < size; i++) {
+		if (!enif_get_list_cell(env, tail, &head, &tail))
+			return opts;
+
+		if (!enif_get_tuple(env, head, &arity, &array))
+			return opts;
+
+		if (arity != 2 ) {
+			return opts;
+		}
+
+		key = array[0];
+		val = array[1];
+
+		if (!enif_compare(key, atoms.diff_opts_find_renames) && !enif_compare(val, atoms.true))
+			opts.flags |= GIT_DIFF_FIND_RENAMES;
+		else if (!enif_compare(key, atoms.diff_opts_find_copies) && !enif_compare(val, atoms.true))
+			opts.flags |= GIT_DIFF_FIND_COPIES;
+		else if (!enif_compare(key, atoms.diff_opts_rename_threshold) && enif_get_uint(env, val, &uval))
+			opts.rename_threshold = uval;
+		else if (!enif_compare(key, atoms.diff_opts_copy_threshold) && enif_get_uint(env, val, &uval))
+			opts.copy_threshold = uval;
+		else if (!enif_compare(key, atoms.diff_opts_rename_limit) && enif_get_uint(env, val, &uval))
+			opts.rename_limit = uval;
 	}
 
-	return enif_make_tuple4(env,
-		enif_make_binary(env, &oid),
-		enif_make_binary(env, &path),
-		enif_make_int64(env, file->size),
-		enif_make_uint(env, file->mode)
-	);
+	return opts;
+}
+
+/*
+ * Runs rename/copy detection on the given diff.
+ *
+ * The cost is bounded in two tiers. libgit2 itself uses rename_limit as the maximum number of
+ * similarity candidates considered per target file. On top of that, like git's diff.renameLimit,
+ * we skip inexact detection altogether and only pair exact (same OID) matches when the number of
+ * source/target pairs exceeds rename_limit squared. Returns 1 when the latter limit was hit.
+ */
+static int diff_find_similar(git_diff *diff, git_diff_find_options *opts)
+{
+	int error, limit_hit = 0;
+	size_t i, sources = 0, targets = 0, limit;
+	const git_diff_delta *delta;
+
+	limit = opts->rename_limit ? opts->rename_limit : DIFF_RENAME_LIMIT;
+
+	for (i = 0; i < git_diff_num_deltas(diff); i++) {
+		delta = git_diff_get_delta(diff, i);
+		if (delta->status == GIT_DELTA_ADDED)
+			targets++;
+		else if (delta->status == GIT_DELTA_DELETED)
+			sources++;
+		else if (delta->status == GIT_DELTA_MODIFIED && (opts->flags & GIT_DIFF_FIND_COPIES))
+			sources++;
+	}
+
+	if (sources * targets > limit * limit) {
+		opts->flags |= GIT_DIFF_FIND_EXACT_MATCH_ONLY;
+		limit_hit = 1;
+	}
+
+	error = git_diff_find_similar(diff, opts);
+	if (error < 0)
+		return error;
+
+	return limit_hit;
+}
+
+static ERL_NIF_TERM diff_status_to_atom(git_delta_t status)
+{
+	switch (status) {
+	case GIT_DELTA_UNMODIFIED:
+		return atoms.diff_unmodified;
+	case GIT_DELTA_ADDED:
+		return atoms.diff_added;
+	case GIT_DELTA_DELETED:
+		return atoms.diff_deleted;
+	case GIT_DELTA_MODIFIED:
+		return atoms.diff_modified;
+	case GIT_DELTA_RENAMED:
+		return atoms.diff_renamed;
+	case GIT_DELTA_COPIED:
+		return atoms.diff_copied;
+	case GIT_DELTA_TYPECHANGE:
+		return atoms.diff_typechange;
+	default:
+		return atoms.undefined;
+	}
 }
 
-static ERL_NIF_TERM diff_line_to_term(ErlNifEnv *env, const git_diff_line *line)
+static int diff_blob_bin_contains(const diff_blob_bin *blob, const git_diff_line *line)
+{
+	return blob->data && line->content >= blob->data && line->content + line->content_len <= blob->data + blob->size;
+}
+
+static ERL_NIF_TERM diff_line_to_term(ErlNifEnv *env, const git_diff_line *line, const diff_blob_bin *old_blob, const diff_blob_bin *new_blob)
 {
 	ErlNifBinary bin;
+	ERL_NIF_TERM content;
 
-	if (enif_alloc_binary(line->content_len, &bin) < 0)
-		return geef_oom(env);
+	/* lines pointing into one of the blobs share its binary instead of being copied */
+	if (diff_blob_bin_contains(old_blob, line)) {
+		content = enif_make_sub_binary(env, old_blob->term, line->content - old_blob->data, line->content_len);
+	} else if (diff_blob_bin_contains(new_blob, line)) {
+		content = enif_make_sub_binary(env, new_blob->term, line->content - new_blob->data, line->content_len);
+	} else {
+		if (!enif_alloc_binary(line->content_len, &bin))
+			return geef_oom(env);
 
-	memcpy(bin.data, line->content, line->content_len);
+		memcpy(bin.data, line->content, line->content_len);
+		content = enif_make_binary(env, &bin);
+	}
 
 	return enif_make_tuple6(env,
 		enif_make_uint(env, line->origin),
@@ -115,11 +206,10 @@ static ERL_NIF_TERM diff_line_to_term(ErlNifEnv *env, const git_diff_line *line)
 		enif_make_int(env, line->new_lineno),
 		enif_make_int(env, line->num_lines),
 		enif_make_int64(env, line->content_offset),
-		enif_make_binary(env, &bin)
+		content
 	);
 }
 
-
 static ERL_NIF_TERM diff_hunk_to_term(ErlNifEnv *env, const git_diff_hunk *hunk)
 {
 	ErlNifBinary header;
@@ -140,58 +230,208 @@ static ERL_NIF_TERM diff_hunk_to_term(ErlNifEnv *env, const git_diff_hunk *hunk)
 
 static ERL_NIF_TERM diff_delta_to_term(ErlNifEnv *env, const git_diff_delta *delta)
 {
-	return enif_make_tuple4(env,
+	return enif_make_tuple5(env,
 		diff_file_to_term(env, &delta->old_file),
 		diff_file_to_term(env, &delta->new_file),
+		diff_status_to_atom(delta->status),
 		enif_make_uint(env, delta->nfiles),
 		enif_make_uint(env, delta->similarity)
 	);
 }
 
-static int diff_delta_file_cb(const git_diff_delta *delta, float progress, void *payload)
+static int diff_blob_bin_lookup(diff_blob_bin *out, ErlNifEnv *env, geef_diff *diff, const git_oid *id)
 {
-	diff_pack* pack = payload;
-	diff_delta *delta_pack = malloc(sizeof(diff_delta));
+	int error;
+	geef_object *obj;
+	const git_blob *blob;
+
+	obj = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!obj)
+		return GIT_ERROR;
+
+	error = geef_object_intern_lookup(obj, diff->repo, id, GIT_OBJ_BLOB);
+	if (error < 0) {
+		enif_release_resource(obj);
+		return error;
+	}
+
+	blob = (git_blob *)obj->obj;
+	out->blob = blob;
+	out->data = git_blob_rawcontent(blob);
+	out->size = git_blob_rawsize(blob);
+	out->term = enif_make_resource_binary(env, obj, out->data, out->size);
+	enif_release_resource(obj);
 
-	*delta_pack = (diff_delta){ diff_delta_to_term(pack->env, delta), NULL, 0 };
-	pack->deltas[pack->size++] = delta_pack;
 	return 0;
 }
 
-static int diff_delta_bin_cb(const git_diff_delta *delta, const git_diff_binary *binary, void *payload)
+static size_t diff_blob_num_lines(const diff_blob_bin *blob)
 {
-	return 0;
+	const char *ptr = blob->data, *end = blob->data + blob->size;
+	size_t num_lines = 0;
+
+	while (ptr < end && (ptr = memchr(ptr, '\n', end - ptr)) != NULL) {
+		num_lines++;
+		ptr++;
+	}
+
+	if (blob->size && blob->data[blob->size - 1] != '\n')
+		num_lines++;
+
+	return num_lines;
 }
 
-static int diff_delta_hunk_cb(const git_diff_delta *delta, const git_diff_hunk *hunk, void *payload)
+/*
+ * Tells whether the patch between two text blobs has more than `max_lines` lines, before generating it. The
+ * difference between the line counts of both sides is a lower bound of the added and deleted lines.
+ */
+static int diff_blobs_too_large(const diff_blob_bin *old_blob, const diff_blob_bin *new_blob, size_t max_lines)
 {
-	diff_pack* pack = payload;
-	diff_delta *last_delta = pack->deltas[pack->size-1];
-	if(last_delta->hunks == NULL) {
-		last_delta->hunks = (diff_hunk **)malloc(sizeof(diff_hunk *));
-		last_delta->size = 1;
-	} else {
-		last_delta->hunks = realloc(last_delta->hunks, sizeof(diff_hunk *) * ++last_delta->size);
+	size_t old_lines, new_lines;
+
+	if (!max_lines ||
+	    (old_blob->blob && git_blob_is_binary(old_blob->blob)) ||
+	    (new_blob->blob && git_blob_is_binary(new_blob->blob)))
+		return 0;
+
+	old_lines = old_blob->blob ? diff_blob_num_lines(old_blob) : 0;
+	new_lines = new_blob->blob ? diff_blob_num_lines(new_blob) : 0;
+
+	return (old_lines > new_lines ? old_lines - new_lines : new_lines - old_lines) > max_lines;
+}
+
+/*
+ * Generates the patch for the delta at the given index from blobs kept alive by resource binaries,
+ * so that line contents can be returned as sub-binaries of the blob contents. Returns 1 without generating
+ * the patch when it would have more than `max_lines` lines (see diff_blobs_too_large()).
+ */
+static int diff_patch_from_delta(git_patch **out, diff_blob_bin *old_blob, diff_blob_bin *new_blob, ErlNifEnv *env, geef_diff *diff, size_t idx, size_t max_lines)
+{
+	int error;
+	const git_diff_delta *delta;
+
+	*old_blob = (diff_blob_bin){ NULL, 0, NULL, 0 };
+	*new_blob = (diff_blob_bin){ NULL, 0, NULL, 0 };
+
+	delta = git_diff_get_delta(diff->diff, idx);
+	if (delta->old_file.mode == GIT_FILEMODE_COMMIT || delta->new_file.mode == GIT_FILEMODE_COMMIT)
+		return git_patch_from_diff(out, diff->diff, idx);
+
+	if (!git_oid_iszero(&delta->old_file.id)) {
+		error = diff_blob_bin_lookup(old_blob, env, diff, &delta->old_file.id);
+		if (error < 0)
+			return error;
 	}
 
-	diff_hunk *delta_hunk = malloc(sizeof(diff_hunk));
+	if (!git_oid_iszero(&delta->new_file.id)) {
+		error = diff_blob_bin_lookup(new_blob, env, diff, &delta->new_file.id);
+		if (error < 0)
+			return error;
+	}
+
+	if (diff_blobs_too_large(old_blob, new_blob, max_lines)) {
+		*out = NULL;
+		return 1;
+	}
+
+	return git_patch_from_blobs(out, old_blob->blob, delta->old_file.path, new_blob->blob, delta->new_file.path, &diff->opts);
+}
+
+/*
+ * Returns the size of the given side of a delta. Tree diffs do not load blobs, in which case the size
+ * is read from the object header, without inflating the object.
+ */
+static int diff_file_size(git_off_t *out, geef_diff *diff, const git_diff_file *file)
+{
+	int error;
+	size_t size;
+	git_otype type;
+	git_odb *odb;
+
+	*out = file->size;
+	if (file->size || git_oid_iszero(&file->id) || file->mode == GIT_FILEMODE_COMMIT)
+		return 0;
+
+	error = git_repository_odb(&odb, diff->repo->repo);
+	if (error < 0)
+		return error;
+
+	error = git_odb_read_header(&size, &type, odb, &file->id);
+	git_odb_free(odb);
+	if (error < 0)
+		return error;
+
+	*out = (git_off_t) size;
+	return 0;
+}
+
+/*
+ * Tells whether either side of the delta at the given index exceeds the iterator size limit,
+ * so that it can be flagged as too large before generating its patch.
+ */
+static int diff_delta_too_large(int *out, geef_diff_iter *iter, size_t idx)
+{
+	int error;
+	git_off_t old_size, new_size;
+	const git_diff_delta *delta;
+
+	*out = 0;
+	if (!iter->max_file_size)
+		return 0;
+
+	delta = git_diff_get_delta(iter->diff->diff, idx);
+	error = diff_file_size(&old_size, iter->diff, &delta->old_file);
+	if (error < 0)
+		return error;
 
-	*delta_hunk = (diff_hunk){ diff_hunk_to_term(pack->env, hunk), delta_hunk->lines = enif_make_list(pack->env, 0) };
-	last_delta->hunks[last_delta->size-1] = delta_hunk;
+	error = diff_file_size(&new_size, iter->diff, &delta->new_file);
+	if (error < 0)
+		return error;
 
+	*out = old_size > iter->max_file_size || new_size > iter->max_file_size;
 	return 0;
 }
 
-static int diff_delta_line_cb(const git_diff_delta *delta, const git_diff_hunk *hunk, const git_diff_line *line, void *payload)
+static int diff_patch_to_term(ERL_NIF_TERM *out, ErlNifEnv *env, git_patch *patch, const diff_blob_bin *old_blob, const diff_blob_bin *new_blob)
 {
-	diff_pack *pack = payload;
-	diff_delta *last_delta = pack->deltas[pack->size-1];
-	diff_hunk *last_hunk = last_delta->hunks[last_delta->size-1];
-	last_hunk->lines = enif_make_list_cell(pack->env, diff_line_to_term(pack->env, line), last_hunk->lines);
+	int error;
+	size_t i, j, num_lines;
+	const git_diff_hunk *hunk;
+	const git_diff_line *line;
+	ERL_NIF_TERM hunks, lines;
+
+	hunks = enif_make_list(env, 0);
+	for (i = git_patch_num_hunks(patch); i > 0; i--) {
+		error = git_patch_get_hunk(&hunk, &num_lines, patch, i - 1);
+		if (error < 0)
+			return error;
+
+		lines = enif_make_list(env, 0);
+		for (j = num_lines; j > 0; j--) {
+			error = git_patch_get_line_in_hunk(&line, patch, i - 1, j - 1);
+			if (error < 0)
+				return error;
+
+			lines = enif_make_list_cell(env, diff_line_to_term(env, line, old_blob, new_blob), lines);
+		}
 
+		hunks = enif_make_list_cell(env, enif_make_tuple2(env, diff_hunk_to_term(env, hunk), lines), hunks);
+	}
+
+	*out = hunks;
 	return 0;
 }
 
+static size_t diff_patch_num_lines(git_patch *patch)
+{
+	size_t context, additions, deletions;
+
+	if (git_patch_line_stats(&context, &additions, &deletions, patch) < 0)
+		return 0;
+
+	return context + additions + deletions;
+}
+
 void geef_diff_free(ErlNifEnv *env, void *cd)
 {
 	geef_diff *diff = (geef_diff *) cd;
@@ -199,6 +439,14 @@ void geef_diff_free(ErlNifEnv *env, void *cd)
 	git_diff_free(diff->diff);
 }
 
+void geef_diff_iter_free(ErlNifEnv *env, void *cd)
+{
+	geef_diff_iter *iter = (geef_diff_iter *) cd;
+	enif_release_resource(iter->diff);
+	if (iter->lock)
+		enif_mutex_destroy(iter->lock);
+}
+
 ERL_NIF_TERM
 geef_diff_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -208,6 +456,7 @@ geef_diff_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	geef_object *new_tree;
 	geef_diff *diff;
 	git_diff_options diff_opts;
+	git_diff_find_options find_opts;
 	ERL_NIF_TERM diff_term;
 
 	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
@@ -230,6 +479,24 @@ geef_diff_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 		return geef_error_struct(env, error);
 	}
 
+	diff->find_limit_hit = 0;
+	find_opts = diff_find_opts_atom2type(env, argv[3]);
+	if (find_opts.flags) {
+		error = diff_find_similar(diff->diff, &find_opts);
+		if (error < 0) {
+			diff->repo = repo;
+			enif_keep_resource(repo);
+			enif_release_resource(diff);
+			return geef_error_struct(env, error);
+		}
+
+		diff->find_limit_hit = error;
+	}
+
+	/* per-file patches are generated from blobs, paths are already filtered */
+	diff->opts = diff_opts;
+	diff->opts.pathspec = (git_strarray){ NULL, 0 };
+
 	diff_term = enif_make_resource(env, diff);
 	enif_release_resource(diff);
 	diff->repo = repo;
@@ -262,6 +529,17 @@ geef_diff_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	return enif_make_tuple4(env, atoms.ok, enif_make_uint(env, files_changed), enif_make_uint(env, insertions), enif_make_uint(env, deletions));
 }
 
+ERL_NIF_TERM
+geef_diff_find_limit_hit(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_diff *diff;
+
+	if (!enif_get_resource(env, argv[0], geef_diff_type, (void **) &diff))
+		return enif_make_badarg(env);
+
+	return diff->find_limit_hit ? atoms.true : atoms.false;
+}
+
 ERL_NIF_TERM
 geef_diff_delta_count(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -273,44 +551,219 @@ geef_diff_delta_count(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	return enif_make_tuple2(env, atoms.ok, enif_make_uint64(env, git_diff_num_deltas(diff->diff)));
 }
 
+ERL_NIF_TERM
+geef_diff_file_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_diff *diff;
+	git_patch *patch;
+	const git_diff_delta *delta;
+	size_t i, context, additions, deletions;
+	ErlNifBinary path;
+	ERL_NIF_TERM stats;
+
+	if (!enif_get_resource(env, argv[0], geef_diff_type, (void **) &diff))
+		return enif_make_badarg(env);
+
+	stats = enif_make_list(env, 0);
+	for (i = git_diff_num_deltas(diff->diff); i > 0; i--) {
+		error = git_patch_from_diff(&patch, diff->diff, i - 1);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		additions = deletions = 0;
+		delta = git_diff_get_delta(diff->diff, i - 1);
+		if (patch) {
+			error = git_patch_line_stats(&context, &additions, &deletions, patch);
+			delta = git_patch_get_delta(patch);
+		}
+
+		if (error < 0) {
+			git_patch_free(patch);
+			return geef_error_struct(env, error);
+		}
+
+		if (geef_string_to_bin(&path, delta->new_file.path) < 0) {
+			git_patch_free(patch);
+			return geef_oom(env);
+		}
+
+		stats = enif_make_list_cell(env, enif_make_tuple5(env,
+			enif_make_binary(env, &path),
+			diff_status_to_atom(delta->status),
+			enif_make_uint64(env, additions),
+			enif_make_uint64(env, deletions),
+			(delta->flags & GIT_DIFF_FLAG_BINARY) ? atoms.true : atoms.false
+		), stats);
+
+		git_patch_free(patch);
+	}
+
+	return enif_make_tuple2(env, atoms.ok, stats);
+}
+
 ERL_NIF_TERM
 geef_diff_deltas(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
 	int error;
-	diff_pack pack;
 	geef_diff *diff;
-	size_t i, j;
+	git_patch *patch;
+	diff_blob_bin old_blob, new_blob;
+	size_t i;
+	ERL_NIF_TERM deltas, hunks;
 
 	if (!enif_get_resource(env, argv[0], geef_diff_type, (void **) &diff))
 		return enif_make_badarg(env);
 
-	pack = (diff_pack){ env, (diff_delta **)malloc(sizeof(git_diff_delta *) * git_diff_num_deltas(diff->diff)), 0};
-	error = git_diff_foreach(diff->diff, diff_delta_file_cb, diff_delta_bin_cb, diff_delta_hunk_cb, diff_delta_line_cb, &pack);
-	if (error < 0)
-		return geef_error_struct(env, error);
+	deltas = enif_make_list(env, 0);
+	for (i = git_diff_num_deltas(diff->diff); i > 0; i--) {
+		error = diff_patch_from_delta(&patch, &old_blob, &new_blob, env, diff, i - 1, 0);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		hunks = enif_make_list(env, 0);
+		if (patch) {
+			error = diff_patch_to_term(&hunks, env, patch, &old_blob, &new_blob);
+			git_patch_free(patch);
+			if (error < 0)
+				return geef_error_struct(env, error);
+		}
+
+		deltas = enif_make_list_cell(env, enif_make_tuple2(env, diff_delta_to_term(env, git_diff_get_delta(diff->diff, i - 1)), hunks), deltas);
+	}
+
+	return enif_make_tuple2(env, atoms.ok, deltas);
+}
+
+ERL_NIF_TERM
+geef_diff_iterator(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_diff *diff;
+	geef_diff_iter *iter;
+	ErlNifUInt64 offset, lines, max_file_lines, max_lines, max_file_size;
+	ERL_NIF_TERM iter_term;
+
+	if (!enif_get_resource(env, argv[0], geef_diff_type, (void **) &diff))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint64(env, argv[1], &offset))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint64(env, argv[2], &lines))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint64(env, argv[3], &max_file_lines))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint64(env, argv[4], &max_lines))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint64(env, argv[5], &max_file_size))
+		return enif_make_badarg(env);
 
-	ERL_NIF_TERM deltas = enif_make_list(env, 0);
-	for (i = 0; i < pack.size; i++) {
-		diff_delta *delta = pack.deltas[i];
-		ERL_NIF_TERM hunks = enif_make_list(env, 0);
-		for (j = 0; j < delta->size; j++) {
-			diff_hunk *hunk = delta->hunks[j];
-			enif_make_reverse_list(env, hunk->lines, &hunk->lines);
-			hunks = enif_make_list_cell(env, enif_make_tuple2(env, hunk->hunk, hunk->lines), hunks);
-			free(hunk);
+	iter = enif_alloc_resource(geef_diff_iter_type, sizeof(geef_diff_iter));
+	if (!iter)
+		return geef_oom(env);
+
+	/* the free callback releases the diff, it must be kept before anything can fail */
+	iter->diff = diff;
+	enif_keep_resource(diff);
+	iter->lock = enif_mutex_create((char *)"geef_diff_iter");
+	if (!iter->lock) {
+		enif_release_resource(iter);
+		return geef_oom(env);
+	}
+
+	iter->next = offset;
+	iter->max_file_lines = max_file_lines;
+	iter->max_lines = max_lines;
+	iter->max_file_size = (git_off_t) max_file_size;
+	iter->lines = lines;
+
+	iter_term = enif_make_resource(env, iter);
+	enif_release_resource(iter);
+
+	return enif_make_tuple2(env, atoms.ok, iter_term);
+}
+
+/* the iterator's position and line budget are shared by the processes holding it, callers hold its lock */
+static ERL_NIF_TERM diff_iterator_next(ErlNifEnv *env, geef_diff_iter *iter, unsigned int count)
+{
+	int error;
+	git_patch *patch;
+	diff_blob_bin old_blob, new_blob;
+	unsigned int i;
+	int too_large;
+	size_t num_deltas, num_lines, max_lines;
+	ERL_NIF_TERM deltas, hunks;
+
+	num_deltas = git_diff_num_deltas(iter->diff->diff);
+	if (iter->next >= num_deltas)
+		return enif_make_tuple2(env, atoms.error, atoms.iterover);
+
+	deltas = enif_make_list(env, 0);
+	for (i = 0; i < count && iter->next < num_deltas; i++, iter->next++) {
+		/* the number of lines the patch of this delta may have, 0 meaning no limit */
+		max_lines = iter->max_file_lines;
+		if (iter->max_lines && (!max_lines || iter->max_lines - iter->lines < max_lines))
+			max_lines = iter->max_lines - iter->lines;
+
+		/* once the total line budget is spent, skip patch generation altogether */
+		if (iter->max_lines && iter->lines >= iter->max_lines) {
+			hunks = atoms.diff_too_large;
+		} else if ((error = diff_delta_too_large(&too_large, iter, iter->next)) < 0) {
+			return geef_error_struct(env, error);
+		} else if (too_large) {
+			hunks = atoms.diff_too_large;
+		} else {
+			error = diff_patch_from_delta(&patch, &old_blob, &new_blob, env, iter->diff, iter->next, max_lines);
+			if (error < 0)
+				return geef_error_struct(env, error);
+
+			hunks = error > 0 ? atoms.diff_too_large : enif_make_list(env, 0);
+			if (patch) {
+				num_lines = diff_patch_num_lines(patch);
+				if (max_lines && num_lines > max_lines) {
+					hunks = atoms.diff_too_large;
+				} else {
+					error = diff_patch_to_term(&hunks, env, patch, &old_blob, &new_blob);
+					iter->lines += num_lines;
+				}
+
+				git_patch_free(patch);
+				if (error < 0)
+					return geef_error_struct(env, error);
+			}
 		}
-		enif_make_reverse_list(env, hunks, &hunks);
-		deltas = enif_make_list_cell(env, enif_make_tuple2(env, delta->delta, hunks), deltas);
-		free(delta->hunks);
-		free(delta);
+
+		deltas = enif_make_list_cell(env, enif_make_tuple2(env, diff_delta_to_term(env, git_diff_get_delta(iter->diff->diff, iter->next)), hunks), deltas);
 	}
 
 	enif_make_reverse_list(env, deltas, &deltas);
-	free(pack.deltas);
 
 	return enif_make_tuple2(env, atoms.ok, deltas);
 }
 
+ERL_NIF_TERM
+geef_diff_iterator_next(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_diff_iter *iter;
+	unsigned int count;
+	ERL_NIF_TERM result;
+
+	if (!enif_get_resource(env, argv[0], geef_diff_iter_type, (void **) &iter))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint(env, argv[1], &count))
+		return enif_make_badarg(env);
+
+	enif_mutex_lock(iter->lock);
+	result = diff_iterator_next(env, iter, count);
+	enif_mutex_unlock(iter->lock);
+
+	return result;
+}
+
 ERL_NIF_TERM
 geef_diff_format(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -320,7 +773,7 @@ geef_diff_format(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	ErlNifBinary data;
 
 	if (!enif_get_resource(env, argv[0], geef_diff_type, (void **) &diff))
-		return enif_make_badarg(env);
+		return geef_badarg(env);
 
 	error = git_diff_to_buf(&buf, diff->diff, diff_format_atom2type(argv[1]));
 	if (error < 0) {
@@ -6,18 +6,36 @@
 #include "repository.h"
 
 extern ErlNifResourceType *geef_diff_type;
+extern ErlNifResourceType *geef_diff_iter_type;
 
 typedef struct {
 	git_diff *diff;
+	git_diff_options opts;
+	int find_limit_hit;
 	geef_repository *repo;
 } geef_diff;
 
+typedef struct {
+	geef_diff *diff;
+	ErlNifMutex *lock;
+	size_t next;
+	size_t max_file_lines;
+	size_t max_lines;
+	git_off_t max_file_size;
+	size_t lines;
+} geef_diff_iter;
+
 void geef_diff_free(ErlNifEnv *env, void *cd);
+void geef_diff_iter_free(ErlNifEnv *env, void *cd);
 
 ERL_NIF_TERM geef_diff_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_diff_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_diff_find_limit_hit(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_diff_delta_count(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_diff_file_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_diff_deltas(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_diff_iterator(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_diff_iterator_next(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_diff_format(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
 #endif
@@ -17,21 +17,29 @@
 #include "revparse.h"
 #include "reflog.h"
 #include "graph.h"
+#include "merge.h"
+#include "refdb.h"
 #include "config.h"
 #include "pack.h"
 #include "worktree.h"
+#include "alloc.h"
+#include "stats.h"
+#include "worker.h"
 #include "geef.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <git2.h>
 
 ErlNifResourceType *geef_repository_type;
 ErlNifResourceType *geef_odb_type;
 ErlNifResourceType *geef_odb_writepack_type;
+ErlNifResourceType *geef_mempack_type;
 ErlNifResourceType *geef_ref_iter_type;
 ErlNifResourceType *geef_object_type;
 ErlNifResourceType *geef_revwalk_type;
 ErlNifResourceType *geef_diff_type;
+ErlNifResourceType *geef_diff_iter_type;
 ErlNifResourceType *geef_index_type;
 ErlNifResourceType *geef_config_type;
 ErlNifResourceType *geef_pack_type;
@@ -39,10 +47,179 @@ ErlNifResourceType *geef_worktree_type;
 
 geef_atoms atoms;
 
+/* Every NIF exported by the library, as GEEF_NIF(name, arity, function, flags). */
+#define GEEF_NIFS(GEEF_NIF) \
+	GEEF_NIF("repository_init", 3, geef_repository_init, 0) \
+	GEEF_NIF("repository_open", 1, geef_repository_open, 0) \
+	GEEF_NIF("repository_open_shared", 1, geef_repository_open_shared, 0) \
+	GEEF_NIF("repository_discover", 1, geef_repository_discover, 0) \
+	GEEF_NIF("repository_bare?", 1, geef_repository_is_bare, 0) \
+	GEEF_NIF("repository_empty?", 1, geef_repository_is_empty, 0) \
+	GEEF_NIF("repository_get_path", 1, geef_repository_path, 0) \
+	GEEF_NIF("repository_get_workdir", 1, geef_repository_workdir, 0) \
+	GEEF_NIF("repository_get_odb", 1, geef_repository_odb, 0) \
+	GEEF_NIF("repository_get_index", 1, geef_repository_index, 0) \
+	GEEF_NIF("repository_get_config", 1, geef_repository_config, 0) \
+	GEEF_NIF("repository_memory", 1, geef_repository_memory, 0) \
+	GEEF_NIF("odb_object_hash", 2, geef_odb_hash, 0) \
+	GEEF_NIF("odb_object_exists?", 2, geef_odb_exists, 0) \
+	GEEF_NIF("odb_read", 2, geef_odb_read, 0) \
+	GEEF_NIF("odb_write", 3, geef_odb_write, 0) \
+	GEEF_NIF("odb_write_pack", 2, geef_odb_write_pack, 0) \
+	GEEF_NIF("odb_get_writepack", 1, geef_odb_get_writepack, 0) \
+	GEEF_NIF("odb_writepack_append", 3, geef_odb_writepack_append, 0) \
+	GEEF_NIF("odb_writepack_commit", 2, geef_odb_writepack_commit, 0) \
+	GEEF_NIF("mempack_new", 1, geef_mempack_new, 0) \
+	GEEF_NIF("mempack_flush", 2, geef_mempack_flush, 0) \
+	GEEF_NIF("mempack_reset", 1, geef_mempack_reset, 0) \
+	GEEF_NIF("reference_list", 1, geef_reference_list, 0) \
+	GEEF_NIF("reference_peel", 3, geef_reference_peel, 0) \
+	GEEF_NIF("reference_to_id", 2, geef_reference_to_id, 0) \
+	GEEF_NIF("reference_glob", 2, geef_reference_glob, 0) \
+	GEEF_NIF("reference_lookup", 2, geef_reference_lookup, 0) \
+	GEEF_NIF("reference_iterator", 2, geef_reference_iterator, 0) \
+	GEEF_NIF("reference_next", 1, geef_reference_next, 0) \
+	GEEF_NIF("reference_list_full", 2, geef_reference_list_full, ERL_NIF_DIRTY_JOB_IO_BOUND) \
+	GEEF_NIF("reference_resolve", 2, geef_reference_resolve, 0) \
+	GEEF_NIF("reference_create", 5, geef_reference_create, 0) \
+	GEEF_NIF("reference_delete", 2, geef_reference_delete, 0) \
+	GEEF_NIF("reference_transaction", 2, geef_reference_transaction, ERL_NIF_DIRTY_JOB_IO_BOUND) \
+	GEEF_NIF("refdb_compress", 1, geef_refdb_compress, ERL_NIF_DIRTY_JOB_IO_BOUND) \
+	GEEF_NIF("refdb_cache_enable", 1, geef_refdb_cache_enable, 0) \
+	GEEF_NIF("reference_dwim", 2, geef_reference_dwim, 0) \
+	GEEF_NIF("reference_log?", 2, geef_reference_has_log, 0) \
+	GEEF_NIF("reflog_count", 2, geef_reflog_count, 0) \
+	GEEF_NIF("reflog_read", 2, geef_reflog_read, 0) \
+	GEEF_NIF("reflog_delete", 2, geef_reflog_delete, 0) \
+	GEEF_NIF("graph_ahead_behind", 3, geef_graph_ahead_behind, 0) \
+	GEEF_NIF("graph_ahead_behind_many", 3, geef_graph_ahead_behind_many, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("graph_descendant_of", 3, geef_graph_descendant_of, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_base", 3, geef_graph_merge_base, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_base_many", 2, geef_graph_merge_base_many, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_base_octopus", 2, geef_graph_merge_base_octopus, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_trees", 4, geef_merge_trees, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_commits", 3, geef_merge_commits, ERL_NIF_DIRTY_JOB_CPU_BOUND) \
+	GEEF_NIF("merge_trees_async", 5, geef_merge_trees_async, 0) \
+	GEEF_NIF("merge_commits_async", 4, geef_merge_commits_async, 0) \
+	GEEF_NIF("oid_fmt", 1, geef_oid_fmt, 0) \
+	GEEF_NIF("oid_parse", 1, geef_oid_parse, 0) \
+	GEEF_NIF("object_repository", 1, geef_object_repository, 0) \
+	GEEF_NIF("object_lookup", 2, geef_object_lookup, 0) \
+	GEEF_NIF("object_id", 1, geef_object_id, 0) \
+	GEEF_NIF("object_zlib_inflate", 2, geef_object_zlib_inflate, 0) \
+	GEEF_NIF("commit_parent", 2, geef_commit_parent, 0) \
+	GEEF_NIF("commit_parent_count", 1, geef_commit_parent_count, 0) \
+	GEEF_NIF("commit_tree", 1, geef_commit_tree, 0) \
+	GEEF_NIF("commit_tree_id", 1, geef_commit_tree_id, 0) \
+	GEEF_NIF("commit_create", 8, geef_commit_create, 0) \
+	GEEF_NIF("commit_message", 1, geef_commit_message, 0) \
+	GEEF_NIF("commit_author", 1, geef_commit_author, 0) \
+	GEEF_NIF("commit_committer", 1, geef_commit_committer, 0) \
+	GEEF_NIF("commit_time", 1, geef_commit_time, 0) \
+	GEEF_NIF("commit_raw_header", 1, geef_commit_raw_header, 0) \
+	GEEF_NIF("commit_header", 2, geef_commit_header, 0) \
+	GEEF_NIF("tree_bypath", 2, geef_tree_bypath, 0) \
+	GEEF_NIF("tree_byid", 2, geef_tree_byid, 0) \
+	GEEF_NIF("tree_nth", 2, geef_tree_nth, 0) \
+	GEEF_NIF("tree_count", 1, geef_tree_count, 0) \
+	GEEF_NIF("tree_update", 3, geef_tree_update, 0) \
+	GEEF_NIF("blob_size", 1, geef_blob_size, 0) \
+	GEEF_NIF("blob_content", 1, geef_blob_content, 0) \
+	GEEF_NIF("tag_list", 1, geef_tag_list, 0) \
+	GEEF_NIF("tag_peel", 1, geef_tag_peel, 0) \
+	GEEF_NIF("tag_name", 1, geef_tag_name, 0) \
+	GEEF_NIF("tag_message", 1, geef_tag_message, 0) \
+	GEEF_NIF("tag_author", 1, geef_tag_author, 0) \
+	GEEF_NIF("library_version", 0, geef_library_version, 0) \
+	GEEF_NIF("library_opts_set", 1, geef_library_opts_set, 0) \
+	GEEF_NIF("library_opts_get", 0, geef_library_opts_get, 0) \
+	GEEF_NIF("library_memory_stats", 0, geef_library_memory_stats, 0) \
+	GEEF_NIF("revwalk_new", 1, geef_revwalk_new, 0) \
+	GEEF_NIF("revwalk_push", 3, geef_revwalk_push, 0) \
+	GEEF_NIF("revwalk_next", 1, geef_revwalk_next, 0) \
+	GEEF_NIF("revwalk_next_chunk", 2, geef_revwalk_next_chunk, 0) \
+	GEEF_NIF("revwalk_pathspec", 2, geef_revwalk_pathspec, 0) \
+	GEEF_NIF("revwalk_sorting", 2, geef_revwalk_sorting, 0) \
+	GEEF_NIF("revwalk_simplify_first_parent", 1, geef_revwalk_simplify_first_parent, 0) \
+	GEEF_NIF("revwalk_reset", 1, geef_revwalk_reset, 0) \
+	GEEF_NIF("revwalk_repository", 1, geef_revwalk_repository, 0) \
+	GEEF_NIF("revwalk_pack", 2, geef_revwalk_pack, 0) \
+	GEEF_NIF("revwalk_pack_async", 3, geef_revwalk_pack_async, 0) \
+	GEEF_NIF("pathspec_match_tree", 2, geef_pathspec_match_tree, 0) \
+	GEEF_NIF("diff_tree", 4, geef_diff_tree, 0) \
+	GEEF_NIF("diff_stats", 1, geef_diff_stats, 0) \
+	GEEF_NIF("diff_find_limit_hit?", 1, geef_diff_find_limit_hit, 0) \
+	GEEF_NIF("diff_delta_count", 1, geef_diff_delta_count, 0) \
+	GEEF_NIF("diff_file_stats", 1, geef_diff_file_stats, 0) \
+	GEEF_NIF("diff_deltas", 1, geef_diff_deltas, 0) \
+	GEEF_NIF("diff_iterator", 6, geef_diff_iterator, 0) \
+	GEEF_NIF("diff_iterator_next", 2, geef_diff_iterator_next, 0) \
+	GEEF_NIF("diff_format", 2, geef_diff_format, 0) \
+	GEEF_NIF("index_new", 0, geef_index_new, 0) \
+	GEEF_NIF("index_read_tree", 2, geef_index_read_tree, 0) \
+	GEEF_NIF("index_write", 1, geef_index_write, 0) \
+	GEEF_NIF("index_write_tree", 1, geef_index_write_tree, 0) \
+	GEEF_NIF("index_write_tree", 2, geef_index_write_tree, 0) \
+	GEEF_NIF("index_add", 2, geef_index_add, 0) \
+	GEEF_NIF("index_remove", 3, geef_index_remove, 0) \
+	GEEF_NIF("index_remove_dir", 3, geef_index_remove_dir, 0) \
+	GEEF_NIF("index_count", 1, geef_index_count, 0) \
+	GEEF_NIF("index_bypath", 3, geef_index_get, 0) \
+	GEEF_NIF("index_nth", 2, geef_index_nth, 0) \
+	GEEF_NIF("index_clear", 1, geef_index_clear, 0) \
+	GEEF_NIF("signature_default", 1, geef_signature_default, 0) \
+	GEEF_NIF("revparse_single", 2, geef_revparse_single, 0) \
+	GEEF_NIF("revparse_ext", 2, geef_revparse_ext, 0) \
+	GEEF_NIF("config_set_bool", 3, geef_config_set_bool, 0) \
+	GEEF_NIF("config_get_bool", 2, geef_config_get_bool, 0) \
+	GEEF_NIF("config_set_string", 3, geef_config_set_string, 0) \
+	GEEF_NIF("config_get_string", 2, geef_config_get_string, 0) \
+	GEEF_NIF("config_open", 1, geef_config_open, 0) \
+	GEEF_NIF("pack_new", 1, geef_pack_new, 0) \
+	GEEF_NIF("pack_insert_commit", 2, geef_pack_insert_commit, 0) \
+	GEEF_NIF("pack_insert_walk", 2, geef_pack_insert_walk, 0) \
+	GEEF_NIF("pack_data", 1, geef_pack_data, 0) \
+	GEEF_NIF("worktree_add", 4, geef_worktree_add, 0) \
+	GEEF_NIF("worktree_prune", 1, geef_worktree_prune, 0) \
+	GEEF_NIF("geef_stats", 1, geef_stats, 0) \
+	GEEF_NIF("async_stats", 0, geef_async_stats, 0)
+
+#define GEEF_NIF_INDEX(name, arity, fptr, flags) GEEF_NIF_##fptr##_##arity,
+enum { GEEF_NIFS(GEEF_NIF_INDEX) GEEF_NIF_COUNT };
+
+/* Wraps each NIF so that its calls and the memory it allocates can be accounted for, see stats.c and alloc.c */
+#define GEEF_NIF_STATS(name, arity, fptr, flags) \
+	static ERL_NIF_TERM fptr##_stats_##arity(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) \
+	{ \
+		ERL_NIF_TERM result; \
+		geef_alloc_owner *prev = geef_alloc_enter(env, argc, argv); \
+		result = geef_stats_call(GEEF_NIF_##fptr##_##arity, fptr, env, argc, argv); \
+		geef_alloc_leave(prev); \
+		return result; \
+	}
+GEEF_NIFS(GEEF_NIF_STATS)
+
+static ErlNifFunc geef_funcs[GEEF_NIF_COUNT];
+
 static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 {
+	if (geef_alloc_init() < 0)
+		return -1;
+
 	git_libgit2_init();
 
+	if (geef_refdb_init() < 0)
+		return -1;
+
+	if (geef_odb_shared_init() < 0)
+		return -1;
+
+	if (geef_stats_init(geef_funcs, GEEF_NIF_COUNT) < 0)
+		return -1;
+
+	if (geef_worker_init(env) < 0)
+		return -1;
+
 	geef_repository_type = enif_open_resource_type(env, NULL,
 		"repository_type", geef_repository_free, ERL_NIF_RT_CREATE, NULL);
 
@@ -61,6 +238,12 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	if (geef_odb_writepack_type == NULL)
 		return -1;
 
+	geef_mempack_type = enif_open_resource_type(env, NULL,
+		"mempack_type", geef_mempack_free, ERL_NIF_RT_CREATE, NULL);
+
+	if (geef_mempack_type == NULL)
+		return -1;
+
 	geef_ref_iter_type = enif_open_resource_type(env, NULL,
 		"ref_iter_type", geef_ref_iter_free, ERL_NIF_RT_CREATE, NULL);
 
@@ -85,6 +268,12 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	if (geef_diff_type == NULL)
 		return -1;
 
+	geef_diff_iter_type = enif_open_resource_type(env, NULL,
+		"diff_iter_type", geef_diff_iter_free, ERL_NIF_RT_CREATE, NULL);
+
+	if (geef_diff_iter_type == NULL)
+		return -1;
+
 	geef_index_type = enif_open_resource_type(env, NULL,
 		"index_type", geef_index_free, ERL_NIF_RT_CREATE, NULL);
 
@@ -121,6 +310,8 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	atoms.tree = enif_make_atom(env, "tree");
 	atoms.blob = enif_make_atom(env, "blob");
 	atoms.tag = enif_make_atom(env, "tag");
+	atoms.tree_upsert = enif_make_atom(env, "upsert");
+	atoms.tree_remove = enif_make_atom(env, "remove");
 	atoms.format_patch = enif_make_atom(env, "patch");
 	atoms.format_patch_header = enif_make_atom(env, "patch_header");
 	atoms.format_raw = enif_make_atom(env, "raw");
@@ -129,6 +320,20 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	atoms.diff_opts_pathspec = enif_make_atom(env, "pathspec");
 	atoms.diff_opts_context_lines = enif_make_atom(env, "context_lines");
 	atoms.diff_opts_interhunk_lines = enif_make_atom(env, "interhunk_lines");
+	atoms.diff_opts_find_renames = enif_make_atom(env, "find_renames");
+	atoms.diff_opts_find_copies = enif_make_atom(env, "find_copies");
+	atoms.diff_opts_rename_threshold = enif_make_atom(env, "rename_threshold");
+	atoms.diff_opts_copy_threshold = enif_make_atom(env, "copy_threshold");
+	atoms.diff_opts_rename_limit = enif_make_atom(env, "rename_limit");
+	atoms.diff_too_large = enif_make_atom(env, "too_large");
+	/* Diff delta status */
+	atoms.diff_unmodified = enif_make_atom(env, "unmodified");
+	atoms.diff_added = enif_make_atom(env, "added");
+	atoms.diff_deleted = enif_make_atom(env, "deleted");
+	atoms.diff_modified = enif_make_atom(env, "modified");
+	atoms.diff_renamed = enif_make_atom(env, "renamed");
+	atoms.diff_copied = enif_make_atom(env, "copied");
+	atoms.diff_typechange = enif_make_atom(env, "typechange");
 	atoms.undefined = enif_make_atom(env, "undefined");
 	atoms.reflog_entry = enif_make_atom(env, "geef_reflog_entry");
 	/* Revwalk */
@@ -136,6 +341,27 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	atoms.timesort    = enif_make_atom(env, "sort_time");
 	atoms.reversesort = enif_make_atom(env, "sort_reverse");
 	atoms.iterover    = enif_make_atom(env, "iterover");
+	/* Library options */
+	atoms.library_cache_max_size = enif_make_atom(env, "cache_max_size");
+	atoms.library_cache_object_limits = enif_make_atom(env, "cache_object_limits");
+	atoms.library_cached_memory = enif_make_atom(env, "cached_memory");
+	atoms.library_enable_caching = enif_make_atom(env, "enable_caching");
+	atoms.library_mwindow_size = enif_make_atom(env, "mwindow_size");
+	atoms.library_mwindow_mapped_limit = enif_make_atom(env, "mwindow_mapped_limit");
+	atoms.library_mwindow_file_limit = enif_make_atom(env, "mwindow_file_limit");
+	atoms.library_strict_hash_verification = enif_make_atom(env, "strict_hash_verification");
+	atoms.library_memory_soft_limit = enif_make_atom(env, "memory_soft_limit");
+	atoms.library_nif_stats = enif_make_atom(env, "nif_stats");
+	atoms.library_async_workers = enif_make_atom(env, "async_workers");
+	/* Memory stats */
+	atoms.memory_total = enif_make_atom(env, "total");
+	atoms.memory_peak = enif_make_atom(env, "peak");
+	atoms.memory_failures = enif_make_atom(env, "failures");
+	atoms.memory_categories = enif_make_atom(env, "categories");
+	/* Async jobs */
+	atoms.geef_async = enif_make_atom(env, "geef_async");
+	atoms.badarg = enif_make_atom(env, "badarg");
+	atoms.cancelled = enif_make_atom(env, "cancelled");
 	/* Indexer progress */
 	atoms.indexer_total_objects = enif_make_atom(env, "total_objects");
 	atoms.indexer_indexed_objects = enif_make_atom(env, "indexed_objects");
@@ -156,6 +382,12 @@ static int load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 	atoms.emsg = enif_make_atom(env, "message");
 	atoms.ecode = enif_make_atom(env, "code");
 
+	if (enif_is_map(env, load_info) && geef_library_opts_apply(env, load_info, 1) != 0)
+		return -1;
+
+	if (geef_worker_start(0) < 0)
+		return -1;
+
 	return 0;
 }
 
@@ -166,6 +398,7 @@ int upgrade(ErlNifEnv* env, void** priv_data, void** old_priv_data, ERL_NIF_TERM
 
 static void unload(ErlNifEnv* env, void* priv_data)
 {
+	geef_worker_shutdown();
 	git_libgit2_shutdown();
 }
 
@@ -247,6 +480,21 @@ geef_oom(ErlNifEnv *env)
 	return enif_make_tuple2(env, atoms.error, atoms.enomem);
 }
 
+/*
+ * Same as enif_make_badarg() for NIFs which also run on the async worker pool. Exceptions can only be raised
+ * from process bound environments, async jobs run on process independent ones and get {error, badarg} instead.
+ */
+ERL_NIF_TERM
+geef_badarg(ErlNifEnv *env)
+{
+	ErlNifPid pid;
+
+	if (enif_self(env, &pid) == NULL)
+		return enif_make_tuple2(env, atoms.error, atoms.badarg);
+
+	return enif_make_badarg(env);
+}
+
 git_strarray git_strarray_from_list(ErlNifEnv *env, ERL_NIF_TERM list)
 {
 	ErlNifBinary bin;
@@ -258,7 +506,7 @@ git_strarray git_strarray_from_list(ErlNifEnv *env, ERL_NIF_TERM list)
 		return array;
 
 	array.count = size;
-	array.strings = malloc(sizeof(char*) * size);
+	array.strings = calloc(size, sizeof(char*));
 
 	tail = list;
 	for(i = 0; i < size; i++) {
@@ -275,6 +523,18 @@ git_strarray git_strarray_from_list(ErlNifEnv *env, ERL_NIF_TERM list)
 	return array;
 }
 
+void geef_strarray_free(git_strarray *array)
+{
+	size_t i;
+
+	for (i = 0; i < array->count; i++)
+		free(array->strings[i]);
+
+	free(array->strings);
+	array->strings = NULL;
+	array->count = 0;
+}
+
 int geef_terminate_binary(ErlNifBinary *bin)
 {
 	if (!enif_realloc_binary(bin, bin->size + 1))
@@ -301,111 +561,10 @@ int geef_string_to_bin(ErlNifBinary *bin, const char *str)
 	return 0;
 }
 
-static ErlNifFunc geef_funcs[] =
+#define GEEF_NIF_FUNC(name, arity, fptr, flags) {name, arity, fptr##_stats_##arity, flags},
+static ErlNifFunc geef_funcs[GEEF_NIF_COUNT] =
 {
-	{"repository_init", 3, geef_repository_init, 0},
-	{"repository_open", 1, geef_repository_open, 0},
-	{"repository_discover", 1, geef_repository_discover, 0},
-	{"repository_bare?", 1, geef_repository_is_bare, 0},
-	{"repository_empty?", 1, geef_repository_is_empty, 0},
-	{"repository_get_path", 1, geef_repository_path, 0},
-	{"repository_get_workdir", 1, geef_repository_workdir, 0},
-	{"repository_get_odb", 1, geef_repository_odb, 0},
-	{"repository_get_index", 1, geef_repository_index, 0},
-	{"repository_get_config", 1, geef_repository_config, 0},
-	{"odb_object_hash", 2, geef_odb_hash, 0},
-	{"odb_object_exists?", 2, geef_odb_exists, 0},
-	{"odb_read", 2, geef_odb_read, 0},
-	{"odb_write", 3, geef_odb_write, 0},
-	{"odb_write_pack", 2, geef_odb_write_pack, 0},
-	{"odb_get_writepack", 1, geef_odb_get_writepack, 0},
-	{"odb_writepack_append", 3, geef_odb_writepack_append, 0},
-	{"odb_writepack_commit", 2, geef_odb_writepack_commit, 0},
-	{"reference_list", 1, geef_reference_list, 0},
-	{"reference_peel", 3, geef_reference_peel, 0},
-	{"reference_to_id", 2, geef_reference_to_id, 0},
-	{"reference_glob", 2, geef_reference_glob, 0},
-	{"reference_lookup", 2, geef_reference_lookup, 0},
-	{"reference_iterator", 2, geef_reference_iterator, 0},
-	{"reference_next", 1, geef_reference_next, 0},
-	{"reference_resolve", 2, geef_reference_resolve, 0},
-	{"reference_create", 5, geef_reference_create, 0},
-	{"reference_delete", 2, geef_reference_delete, 0},
-	{"reference_dwim", 2,   geef_reference_dwim, 0},
-	{"reference_log?", 2, geef_reference_has_log, 0},
-	{"reflog_count", 2, geef_reflog_count, 0},
-	{"reflog_read", 2, geef_reflog_read, 0},
-	{"reflog_delete", 2, geef_reflog_delete, 0},
-	{"graph_ahead_behind", 3, geef_graph_ahead_behind, 0},
-	{"oid_fmt", 1, geef_oid_fmt, 0},
-	{"oid_parse", 1, geef_oid_parse, 0},
-	{"object_repository", 1, geef_object_repository, 0},
-	{"object_lookup", 2, geef_object_lookup, 0},
-	{"object_id", 1, geef_object_id, 0},
-	{"object_zlib_inflate", 2, geef_object_zlib_inflate, 0},
-	{"commit_parent", 2, geef_commit_parent, 0},
-	{"commit_parent_count", 1, geef_commit_parent_count, 0},
-	{"commit_tree", 1, geef_commit_tree, 0},
-	{"commit_tree_id", 1, geef_commit_tree_id, 0},
-	{"commit_create",  8, geef_commit_create, 0},
-	{"commit_message", 1, geef_commit_message, 0},
-	{"commit_author", 1, geef_commit_author, 0},
-	{"commit_committer", 1, geef_commit_committer, 0},
-	{"commit_time", 1, geef_commit_time, 0},
-	{"commit_raw_header", 1, geef_commit_raw_header, 0},
-	{"commit_header", 2, geef_commit_header, 0},
-	{"tree_bypath", 2, geef_tree_bypath, 0},
-	{"tree_byid", 2, geef_tree_byid, 0},
-	{"tree_nth", 2, geef_tree_nth, 0},
-	{"tree_count", 1, geef_tree_count, 0},
-	{"blob_size", 1, geef_blob_size, 0},
-	{"blob_content", 1, geef_blob_content, 0},
-	{"tag_list", 1, geef_tag_list, 0},
-	{"tag_peel", 1, geef_tag_peel, 0},
-	{"tag_name", 1, geef_tag_name, 0},
-	{"tag_message", 1, geef_tag_message, 0},
-	{"tag_author", 1, geef_tag_author, 0},
-	{"library_version", 0, geef_library_version, 0},
-	{"revwalk_new",  1, geef_revwalk_new, 0},
-	{"revwalk_push", 3, geef_revwalk_push, 0},
-	{"revwalk_next", 1, geef_revwalk_next, 0},
-	{"revwalk_sorting", 2, geef_revwalk_sorting, 0},
-	{"revwalk_simplify_first_parent", 1, geef_revwalk_simplify_first_parent, 0},
-	{"revwalk_reset", 1,   geef_revwalk_reset, 0},
-	{"revwalk_repository", 1, geef_revwalk_repository, 0},
-	{"revwalk_pack", 1, geef_revwalk_pack, 0},
-	{"pathspec_match_tree", 2, geef_pathspec_match_tree, 0},
-	{"diff_tree", 4, geef_diff_tree, 0},
-	{"diff_stats", 1, geef_diff_stats, 0},
-	{"diff_delta_count", 1, geef_diff_delta_count, 0},
-	{"diff_deltas", 1, geef_diff_deltas, 0},
-	{"diff_format", 2, geef_diff_format, 0},
-	{"index_new", 0, geef_index_new, 0},
-	{"index_read_tree", 2, geef_index_read_tree, 0},
-	{"index_write", 1, geef_index_write, 0},
-	{"index_write_tree", 1, geef_index_write_tree, 0},
-	{"index_write_tree", 2, geef_index_write_tree, 0},
-	{"index_add", 2, geef_index_add, 0},
-	{"index_remove", 3, geef_index_remove, 0},
-	{"index_remove_dir", 3, geef_index_remove_dir, 0},
-	{"index_count", 1, geef_index_count, 0},
-	{"index_bypath", 3, geef_index_get, 0},
-	{"index_nth", 2, geef_index_nth, 0},
-	{"index_clear", 1, geef_index_clear, 0},
-	{"signature_default", 1, geef_signature_default, 0},
-	{"revparse_single", 2, geef_revparse_single, 0},
-	{"revparse_ext", 2, geef_revparse_ext, 0},
-	{"config_set_bool", 3, geef_config_set_bool, 0},
-	{"config_get_bool", 2, geef_config_get_bool, 0},
-	{"config_set_string", 3, geef_config_set_string, 0},
-	{"config_get_string", 2, geef_config_get_string, 0},
-	{"config_open", 1, geef_config_open, 0},
-	{"pack_new", 1, geef_pack_new, 0},
-	{"pack_insert_commit", 2, geef_pack_insert_commit, 0},
-	{"pack_insert_walk", 2, geef_pack_insert_walk, 0},
-	{"pack_data", 1, geef_pack_data, 0},
-	{"worktree_add", 4, geef_worktree_add, 0},
-	{"worktree_prune", 1, geef_worktree_prune, 0},
+	GEEF_NIFS(GEEF_NIF_FUNC)
 };
 
 ERL_NIF_INIT(Elixir.GitRekt.Git, geef_funcs, load, NULL, upgrade, unload)
@@ -4,9 +4,13 @@
 #include <git2.h>
 #include "erl_nif.h"
 
+#define GEEF_LIBGIT2_VERSION_CHECK(major, minor) \
+	(LIBGIT2_VER_MAJOR > (major) || (LIBGIT2_VER_MAJOR == (major) && LIBGIT2_VER_MINOR >= (minor)))
+
 ERL_NIF_TERM geef_error(ErlNifEnv *env);
 ERL_NIF_TERM geef_error_struct(ErlNifEnv *env, int code);
 ERL_NIF_TERM geef_oom(ErlNifEnv *env);
+ERL_NIF_TERM geef_badarg(ErlNifEnv *env);
 
 typedef struct {
 	ERL_NIF_TERM ok;
@@ -21,6 +25,8 @@ typedef struct {
 	ERL_NIF_TERM tree;
 	ERL_NIF_TERM blob;
 	ERL_NIF_TERM tag;
+	ERL_NIF_TERM tree_upsert;
+	ERL_NIF_TERM tree_remove;
 	ERL_NIF_TERM format_patch;
 	ERL_NIF_TERM format_patch_header;
 	ERL_NIF_TERM format_raw;
@@ -29,6 +35,19 @@ typedef struct {
 	ERL_NIF_TERM diff_opts_pathspec;
 	ERL_NIF_TERM diff_opts_context_lines;
 	ERL_NIF_TERM diff_opts_interhunk_lines;
+	ERL_NIF_TERM diff_opts_find_renames;
+	ERL_NIF_TERM diff_opts_find_copies;
+	ERL_NIF_TERM diff_opts_rename_threshold;
+	ERL_NIF_TERM diff_opts_copy_threshold;
+	ERL_NIF_TERM diff_opts_rename_limit;
+	ERL_NIF_TERM diff_too_large;
+	ERL_NIF_TERM diff_unmodified;
+	ERL_NIF_TERM diff_added;
+	ERL_NIF_TERM diff_deleted;
+	ERL_NIF_TERM diff_modified;
+	ERL_NIF_TERM diff_renamed;
+	ERL_NIF_TERM diff_copied;
+	ERL_NIF_TERM diff_typechange;
 	ERL_NIF_TERM undefined;
 	ERL_NIF_TERM toposort;
 	ERL_NIF_TERM timesort;
@@ -36,6 +55,27 @@ typedef struct {
 	ERL_NIF_TERM iterover;
 	ERL_NIF_TERM reflog_entry;
 
+	ERL_NIF_TERM library_cache_max_size;
+	ERL_NIF_TERM library_cache_object_limits;
+	ERL_NIF_TERM library_cached_memory;
+	ERL_NIF_TERM library_enable_caching;
+	ERL_NIF_TERM library_mwindow_size;
+	ERL_NIF_TERM library_mwindow_mapped_limit;
+	ERL_NIF_TERM library_mwindow_file_limit;
+	ERL_NIF_TERM library_strict_hash_verification;
+	ERL_NIF_TERM library_memory_soft_limit;
+	ERL_NIF_TERM library_nif_stats;
+	ERL_NIF_TERM library_async_workers;
+
+	ERL_NIF_TERM memory_total;
+	ERL_NIF_TERM memory_peak;
+	ERL_NIF_TERM memory_failures;
+	ERL_NIF_TERM memory_categories;
+
+	ERL_NIF_TERM geef_async;
+	ERL_NIF_TERM badarg;
+	ERL_NIF_TERM cancelled;
+
 	ERL_NIF_TERM indexer_total_objects;
 	ERL_NIF_TERM indexer_indexed_objects;
 	ERL_NIF_TERM indexer_received_objects;
@@ -59,6 +99,8 @@ typedef struct {
 extern geef_atoms atoms;
 
 git_strarray git_strarray_from_list(ErlNifEnv *env, ERL_NIF_TERM list);
+/** Free an array built by git_strarray_from_list(), libgit2 must not free it as it uses its own allocator */
+void geef_strarray_free(git_strarray *array);
 
 /** NUL-terminate a binary */
 int geef_terminate_binary(ErlNifBinary *bin);
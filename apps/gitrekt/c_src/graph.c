@@ -3,10 +3,372 @@
 #include "graph.h"
 #include "oid.h"
 #include "signature.h"
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <git2.h>
 #include <git2/sys/commit.h>
 
+/*
+ * Paints the commit graph from a base commit and many tips at once. Each commit carries one bit for the
+ * base and one bit per tip, bits are propagated to parents in commit time order. A commit carrying every bit
+ * is stale, as are its ancestors, and the walk stops once only stale commits are queued (as git's
+ * paint_down_to_common() does), so the common history is visited only once.
+ *
+ * The bits of a commit fit a single word, tips are painted by batches of GRAPH_TIPS_MAX. Each commit is read
+ * once, its time and parents being kept along with its bits. Memory comes from the BEAM allocator.
+ *
+ * Commit times may be skewed, a parent being dated after its child. The time of a commit is corrected to be
+ * older than the child it is first reached from, a commit reached again with new bits once walked is walked
+ * again, and the walk goes on for GRAPH_SLOP commits once only stale commits are queued (as git's revision
+ * walk does). libgit2 does not expose the generation numbers of the commit-graph file, and computing them
+ * requires reading the whole history down to its roots, defeating the early stop.
+ */
+
+#define GRAPH_TIPS_MAX 63
+#define GRAPH_SLOP 5
+
+/* commits walked by a single ahead/behind batch, counts are lower bounds past it */
+#define GRAPH_NODES_MAX (1 << 18)
+
+typedef struct {
+	git_oid id;
+	git_time_t time;
+	uint64_t bits;
+	size_t parents;
+	unsigned int nparents;
+	int state;
+} graph_node;
+
+typedef struct {
+	git_repository *repo;
+	graph_node *nodes;
+	size_t nodes_len, nodes_cap, nodes_max;
+	git_oid *parents;
+	size_t parents_len, parents_cap;
+	size_t *table;
+	size_t table_cap;
+	size_t *heap;
+	size_t heap_len, heap_cap;
+	size_t active;
+	uint64_t stale;
+} graph_paint;
+
+enum {
+	GRAPH_NODE_NEW,
+	GRAPH_NODE_QUEUED,
+	GRAPH_NODE_DONE
+};
+
+static void graph_paint_init(graph_paint *paint, git_repository *repo, unsigned int nbits, size_t nodes_max)
+{
+	memset(paint, 0, sizeof(graph_paint));
+	paint->repo = repo;
+	paint->nodes_max = nodes_max;
+	paint->stale = nbits == 64 ? UINT64_MAX : (UINT64_C(1) << nbits) - 1;
+}
+
+static void graph_paint_free(graph_paint *paint)
+{
+	if (paint->nodes)
+		enif_free(paint->nodes);
+	if (paint->parents)
+		enif_free(paint->parents);
+	if (paint->table)
+		enif_free(paint->table);
+	if (paint->heap)
+		enif_free(paint->heap);
+}
+
+static void *graph_realloc(void *ptr, size_t size)
+{
+	return ptr ? enif_realloc(ptr, size) : enif_alloc(size);
+}
+
+static size_t graph_oid_hash(const git_oid *id)
+{
+	size_t hash;
+
+	memcpy(&hash, id->id, sizeof(hash));
+	return hash;
+}
+
+static int graph_table_grow(graph_paint *paint)
+{
+	size_t *table, cap, i, j;
+
+	cap = paint->table_cap ? paint->table_cap * 2 : 1024;
+	table = enif_alloc(cap * sizeof(size_t));
+	if (table == NULL)
+		return -1;
+
+	memset(table, 0, cap * sizeof(size_t));
+	for (i = 0; i < paint->nodes_len; i++) {
+		j = graph_oid_hash(&paint->nodes[i].id) & (cap - 1);
+		while (table[j])
+			j = (j + 1) & (cap - 1);
+		table[j] = i + 1;
+	}
+
+	if (paint->table)
+		enif_free(paint->table);
+	paint->table = table;
+	paint->table_cap = cap;
+
+	return 0;
+}
+
+static int graph_node_get(size_t *out, graph_paint *paint, const git_oid *id)
+{
+	int error;
+	size_t j, cap;
+	unsigned int i, nparents;
+	git_commit *commit;
+	graph_node *nodes;
+	git_oid *parents;
+
+	if (paint->nodes_len * 2 >= paint->table_cap && graph_table_grow(paint) < 0)
+		return GIT_ERROR;
+
+	j = graph_oid_hash(id) & (paint->table_cap - 1);
+	while (paint->table[j]) {
+		if (git_oid_equal(&paint->nodes[paint->table[j] - 1].id, id)) {
+			*out = paint->table[j] - 1;
+			return 0;
+		}
+		j = (j + 1) & (paint->table_cap - 1);
+	}
+
+	if (paint->nodes_len == paint->nodes_cap) {
+		cap = paint->nodes_cap ? paint->nodes_cap * 2 : 512;
+		nodes = graph_realloc(paint->nodes, cap * sizeof(graph_node));
+		if (nodes == NULL)
+			return GIT_ERROR;
+		paint->nodes = nodes;
+		paint->nodes_cap = cap;
+	}
+
+	error = git_commit_lookup(&commit, paint->repo, id);
+	if (error < 0)
+		return error;
+
+	nparents = git_commit_parentcount(commit);
+	if (paint->parents_len + nparents > paint->parents_cap) {
+		cap = paint->parents_cap ? paint->parents_cap * 2 : 1024;
+		while (cap < paint->parents_len + nparents)
+			cap *= 2;
+		parents = graph_realloc(paint->parents, cap * sizeof(git_oid));
+		if (parents == NULL) {
+			git_commit_free(commit);
+			return GIT_ERROR;
+		}
+		paint->parents = parents;
+		paint->parents_cap = cap;
+	}
+
+	*out = paint->nodes_len++;
+	git_oid_cpy(&paint->nodes[*out].id, id);
+	paint->nodes[*out].time = git_commit_time(commit);
+	paint->nodes[*out].bits = 0;
+	paint->nodes[*out].parents = paint->parents_len;
+	paint->nodes[*out].nparents = nparents;
+	paint->nodes[*out].state = GRAPH_NODE_NEW;
+	for (i = 0; i < nparents; i++)
+		git_oid_cpy(&paint->parents[paint->parents_len++], git_commit_parent_id(commit, i));
+	paint->table[j] = *out + 1;
+
+	git_commit_free(commit);
+
+	return 0;
+}
+
+static void graph_heap_push(graph_paint *paint, size_t idx)
+{
+	size_t i, parent;
+
+	i = paint->heap_len++;
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (paint->nodes[paint->heap[parent]].time >= paint->nodes[idx].time)
+			break;
+		paint->heap[i] = paint->heap[parent];
+		i = parent;
+	}
+	paint->heap[i] = idx;
+}
+
+static size_t graph_heap_pop(graph_paint *paint)
+{
+	size_t top, last, i, child;
+
+	top = paint->heap[0];
+	last = paint->heap[--paint->heap_len];
+
+	i = 0;
+	while ((child = 2 * i + 1) < paint->heap_len) {
+		if (child + 1 < paint->heap_len &&
+		    paint->nodes[paint->heap[child + 1]].time > paint->nodes[paint->heap[child]].time)
+			child++;
+		if (paint->nodes[last].time >= paint->nodes[paint->heap[child]].time)
+			break;
+		paint->heap[i] = paint->heap[child];
+		i = child;
+	}
+	paint->heap[i] = last;
+
+	return top;
+}
+
+/* paints the node with `bits` from a child dated `time`, or from nothing when painting the starting commits */
+static int graph_node_paint(graph_paint *paint, size_t idx, uint64_t bits, const git_time_t *time)
+{
+	graph_node *node = &paint->nodes[idx];
+	size_t *heap;
+	int stale;
+
+	if (node->state == GRAPH_NODE_DONE && (node->bits | bits) == node->bits)
+		return 0;
+
+	stale = node->bits == paint->stale;
+	node->bits |= bits;
+
+	if (node->state == GRAPH_NODE_NEW && time && node->time >= *time)
+		node->time = *time - 1;
+
+	if (node->state != GRAPH_NODE_QUEUED) {
+		/* a node is queued at most once at a time, so the heap never outgrows the node pool */
+		if (paint->heap_cap < paint->nodes_cap) {
+			heap = graph_realloc(paint->heap, paint->nodes_cap * sizeof(size_t));
+			if (heap == NULL)
+				return GIT_ERROR;
+			paint->heap = heap;
+			paint->heap_cap = paint->nodes_cap;
+		}
+
+		node->state = GRAPH_NODE_QUEUED;
+		graph_heap_push(paint, idx);
+		if (node->bits != paint->stale)
+			paint->active++;
+	} else if (!stale && node->bits == paint->stale) {
+		paint->active--;
+	}
+
+	return 0;
+}
+
+/*
+ * Pops queued commits in commit time order and propagates their bits to their parents, until only stale
+ * commits have been queued for GRAPH_SLOP commits or `nodes_max` commits have been read.
+ */
+static int graph_paint_walk(graph_paint *paint)
+{
+	int error;
+	size_t idx, pidx;
+	unsigned int i, slop = GRAPH_SLOP;
+	uint64_t bits;
+	git_oid id;
+
+	while (paint->heap_len > 0) {
+		if (paint->active == 0 && slop-- == 0)
+			break;
+
+		if (paint->nodes_max && paint->nodes_len >= paint->nodes_max)
+			break;
+
+		idx = graph_heap_pop(paint);
+		bits = paint->nodes[idx].bits;
+		if (bits != paint->stale)
+			paint->active--;
+
+		paint->nodes[idx].state = GRAPH_NODE_DONE;
+
+		for (i = 0; i < paint->nodes[idx].nparents; i++) {
+			/* reading a parent may move the parent ids around */
+			git_oid_cpy(&id, &paint->parents[paint->nodes[idx].parents + i]);
+			if ((error = graph_node_get(&pidx, paint, &id)) < 0 ||
+			    (error = graph_node_paint(paint, pidx, bits, &paint->nodes[idx].time)) < 0)
+				return error;
+		}
+	}
+
+	return 0;
+}
+
+static int graph_oids_from_list(git_oid **out, size_t *len, ErlNifEnv *env, ERL_NIF_TERM list)
+{
+	ERL_NIF_TERM head, tail;
+	ErlNifBinary bin;
+	unsigned int count, i;
+	git_oid *oids;
+
+	if (!enif_get_list_length(env, list, &count))
+		return 0;
+
+	oids = calloc(count ? count : 1, sizeof(git_oid));
+	if (oids == NULL)
+		return 0;
+
+	tail = list;
+	for (i = 0; i < count; i++) {
+		if (!enif_get_list_cell(env, tail, &head, &tail) ||
+		    !enif_inspect_binary(env, head, &bin) || bin.size != GIT_OID_RAWSZ) {
+			free(oids);
+			return 0;
+		}
+
+		git_oid_fromraw(&oids[i], bin.data);
+	}
+
+	*out = oids;
+	*len = count;
+
+	return 1;
+}
+
+/* paints `base` and `ntips` tips from bit 1 onwards, then counts the commits each tip is ahead and behind */
+static int graph_ahead_behind_batch(uint64_t *ahead, uint64_t *behind, git_repository *repo, const git_oid *base, const git_oid *tips, size_t ntips)
+{
+	int error;
+	graph_paint paint;
+	size_t idx, i, j;
+	uint64_t bits;
+
+	graph_paint_init(&paint, repo, ntips + 1, GRAPH_NODES_MAX);
+
+	if ((error = graph_node_get(&idx, &paint, base)) < 0 ||
+	    (error = graph_node_paint(&paint, idx, 1, NULL)) < 0)
+		goto cleanup;
+
+	for (i = 0; i < ntips; i++) {
+		if ((error = graph_node_get(&idx, &paint, &tips[i])) < 0 ||
+		    (error = graph_node_paint(&paint, idx, UINT64_C(1) << (i + 1), NULL)) < 0)
+			goto cleanup;
+	}
+
+	if ((error = graph_paint_walk(&paint)) < 0)
+		goto cleanup;
+
+	for (idx = 0; idx < paint.nodes_len; idx++) {
+		bits = paint.nodes[idx].bits;
+		if (bits == paint.stale)
+			continue;
+
+		for (j = 0; j < ntips; j++) {
+			int from_tip = (bits >> (j + 1)) & 1;
+			int from_base = bits & 1;
+
+			if (from_tip && !from_base)
+				ahead[j]++;
+			else if (from_base && !from_tip)
+				behind[j]++;
+		}
+	}
+
+cleanup:
+	graph_paint_free(&paint);
+	return error;
+}
+
 ERL_NIF_TERM
 geef_graph_ahead_behind(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -40,4 +402,206 @@ geef_graph_ahead_behind(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 		return geef_error_struct(env, error);
 
 	return enif_make_tuple3(env, atoms.ok, enif_make_uint64(env, ahead), enif_make_uint64(env, behind));
-}
\ No newline at end of file
+}
+ERL_NIF_TERM
+geef_graph_ahead_behind_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error = 0;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	ERL_NIF_TERM list;
+	git_oid base, *tips;
+	size_t ntips, i;
+	uint64_t *ahead = NULL, *behind = NULL;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!enif_inspect_binary(env, argv[1], &bin) || bin.size != GIT_OID_RAWSZ)
+		return enif_make_badarg(env);
+
+	git_oid_fromraw(&base, bin.data);
+
+	if (!graph_oids_from_list(&tips, &ntips, env, argv[2]))
+		return enif_make_badarg(env);
+
+	list = enif_make_list(env, 0);
+	ahead = enif_alloc((ntips ? ntips : 1) * sizeof(uint64_t));
+	behind = enif_alloc((ntips ? ntips : 1) * sizeof(uint64_t));
+	if (ahead == NULL || behind == NULL) {
+		error = GIT_ERROR;
+		goto cleanup;
+	}
+
+	memset(ahead, 0, (ntips ? ntips : 1) * sizeof(uint64_t));
+	memset(behind, 0, (ntips ? ntips : 1) * sizeof(uint64_t));
+
+	/* a stale tip only keeps walking the history of its own batch */
+	for (i = 0; i < ntips; i += GRAPH_TIPS_MAX) {
+		error = graph_ahead_behind_batch(ahead + i, behind + i, repo->repo, &base, tips + i, ntips - i < GRAPH_TIPS_MAX ? ntips - i : GRAPH_TIPS_MAX);
+		if (error < 0)
+			goto cleanup;
+	}
+
+	for (i = ntips; i > 0; i--)
+		list = enif_make_list_cell(env, enif_make_tuple2(env, enif_make_uint64(env, ahead[i - 1]), enif_make_uint64(env, behind[i - 1])), list);
+
+cleanup:
+	if (ahead)
+		enif_free(ahead);
+	if (behind)
+		enif_free(behind);
+	free(tips);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return enif_make_tuple2(env, atoms.ok, list);
+}
+
+ERL_NIF_TERM
+geef_graph_merge_base(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	git_oid one, two, base;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!enif_inspect_binary(env, argv[1], &bin) || bin.size != GIT_OID_RAWSZ)
+		return enif_make_badarg(env);
+
+	git_oid_fromraw(&one, bin.data);
+
+	if (!enif_inspect_binary(env, argv[2], &bin) || bin.size != GIT_OID_RAWSZ)
+		return enif_make_badarg(env);
+
+	git_oid_fromraw(&two, bin.data);
+
+	error = git_merge_base(&base, repo->repo, &one, &two);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (geef_oid_bin(&bin, &base) < 0)
+		return geef_oom(env);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_binary(env, &bin));
+}
+
+ERL_NIF_TERM
+geef_graph_merge_base_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	git_oid *oids, base;
+	size_t len;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!graph_oids_from_list(&oids, &len, env, argv[1]))
+		return enif_make_badarg(env);
+
+	error = git_merge_base_many(&base, repo->repo, len, oids);
+	free(oids);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (geef_oid_bin(&bin, &base) < 0)
+		return geef_oom(env);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_binary(env, &bin));
+}
+
+ERL_NIF_TERM
+geef_graph_merge_base_octopus(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	git_oid *oids, base;
+	size_t len;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!graph_oids_from_list(&oids, &len, env, argv[1]))
+		return enif_make_badarg(env);
+
+	error = git_merge_base_octopus(&base, repo->repo, len, oids);
+	free(oids);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (geef_oid_bin(&bin, &base) < 0)
+		return geef_oom(env);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_binary(env, &bin));
+}
+
+/*
+ * Checks many candidate ancestors in a single painting walk: bit 0 marks commits reachable from the given
+ * commit, bit 1 the ones reachable from any candidate. Once the walk stops, a candidate is an ancestor
+ * iff it carries bit 0. A commit counts as a descendant of itself, as in git.
+ */
+ERL_NIF_TERM
+geef_graph_descendant_of(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error = 0;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	ERL_NIF_TERM list;
+	git_oid commit, *ancestors;
+	graph_paint paint;
+	size_t len, i, idx, *nodes = NULL;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!enif_inspect_binary(env, argv[1], &bin) || bin.size != GIT_OID_RAWSZ)
+		return enif_make_badarg(env);
+
+	git_oid_fromraw(&commit, bin.data);
+
+	if (!graph_oids_from_list(&ancestors, &len, env, argv[2]))
+		return enif_make_badarg(env);
+
+	list = enif_make_list(env, 0);
+	graph_paint_init(&paint, repo->repo, 2, 0);
+
+	nodes = calloc(len ? len : 1, sizeof(size_t));
+	if (nodes == NULL) {
+		error = GIT_ERROR;
+		goto cleanup;
+	}
+
+	if ((error = graph_node_get(&idx, &paint, &commit)) < 0 ||
+	    (error = graph_node_paint(&paint, idx, 1, NULL)) < 0)
+		goto cleanup;
+
+	for (i = 0; i < len; i++) {
+		if ((error = graph_node_get(&nodes[i], &paint, &ancestors[i])) < 0 ||
+		    (error = graph_node_paint(&paint, nodes[i], 2, NULL)) < 0)
+			goto cleanup;
+	}
+
+	error = graph_paint_walk(&paint);
+	if (error < 0)
+		goto cleanup;
+
+	for (i = len; i > 0; i--)
+		list = enif_make_list_cell(env, (paint.nodes[nodes[i - 1]].bits & 1) ? atoms.true : atoms.false, list);
+
+cleanup:
+	free(nodes);
+	free(ancestors);
+	graph_paint_free(&paint);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return enif_make_tuple2(env, atoms.ok, list);
+}
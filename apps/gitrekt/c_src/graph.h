@@ -2,6 +2,11 @@
 #define GEEF_GRAPH_H
 
 ERL_NIF_TERM geef_graph_ahead_behind(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_graph_ahead_behind_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_graph_merge_base(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_graph_merge_base_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_graph_merge_base_octopus(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_graph_descendant_of(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
 #endif
 
@@ -1,4 +1,10 @@
 #include "erl_nif.h"
+#include "geef.h"
+#include "object.h"
+#include "library.h"
+#include "alloc.h"
+#include "stats.h"
+#include "worker.h"
 #include <git2.h>
 
 ERL_NIF_TERM geef_library_version(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
@@ -9,3 +15,236 @@ ERL_NIF_TERM geef_library_version(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
 
 	return enif_make_tuple3(env, enif_make_int(env, major), enif_make_int(env, minor), enif_make_int(env, rev));
 }
+
+/*
+ * libgit2 has no getters for the following options, the values last set are kept here so that they can be
+ * reported by geef_library_opts_get(), initialized to libgit2's defaults.
+ */
+static int library_enable_caching = 1;
+static int library_strict_hash_verification = 1;
+static size_t library_object_limits[GIT_OBJ_TAG + 1] = {
+	[GIT_OBJ_COMMIT] = 4096,
+	[GIT_OBJ_TREE] = 4096,
+	[GIT_OBJ_BLOB] = 0,
+	[GIT_OBJ_TAG] = 4096,
+};
+
+static int library_opt_size(size_t *out, ErlNifEnv *env, ERL_NIF_TERM term)
+{
+	ErlNifUInt64 size;
+
+	if (!enif_get_uint64(env, term, &size))
+		return 0;
+
+	*out = (size_t)size;
+	return 1;
+}
+
+static int library_opt_bool(int *out, ERL_NIF_TERM term)
+{
+	if (enif_is_identical(term, atoms.true))
+		*out = 1;
+	else if (enif_is_identical(term, atoms.false))
+		*out = 0;
+	else
+		return 0;
+
+	return 1;
+}
+
+static int library_opt_object_limits(ErlNifEnv *env, ERL_NIF_TERM limits)
+{
+	ErlNifMapIterator iter;
+	ERL_NIF_TERM key, value;
+	git_otype type;
+	size_t size;
+	int error = 0;
+
+	if (!enif_map_iterator_create(env, limits, &iter, ERL_NIF_MAP_ITERATOR_FIRST))
+		return 1;
+
+	while (error == 0 && enif_map_iterator_get_pair(env, &iter, &key, &value)) {
+		type = geef_object_atom2type(key);
+		if (type == GIT_OBJ_BAD || type == GIT_OBJ_ANY || !library_opt_size(&size, env, value))
+			error = 1;
+		else
+			error = git_libgit2_opts(GIT_OPT_SET_CACHE_OBJECT_LIMIT, type, size);
+
+		if (error == 0)
+			library_object_limits[type] = size;
+
+		enif_map_iterator_next(env, &iter);
+	}
+
+	enif_map_iterator_destroy(env, &iter);
+	return error;
+}
+
+/* Returns a positive value if the option is unknown or its value is invalid. */
+static int library_opt_set(ErlNifEnv *env, ERL_NIF_TERM key, ERL_NIF_TERM value)
+{
+	size_t size;
+	int enabled, error;
+
+	if (enif_is_identical(key, atoms.library_cache_max_size)) {
+		if (!library_opt_size(&size, env, value))
+			return 1;
+		return git_libgit2_opts(GIT_OPT_SET_CACHE_MAX_SIZE, (ssize_t)size);
+	}
+
+	if (enif_is_identical(key, atoms.library_cache_object_limits))
+		return library_opt_object_limits(env, value);
+
+	if (enif_is_identical(key, atoms.library_enable_caching)) {
+		if (!library_opt_bool(&enabled, value))
+			return 1;
+		if ((error = git_libgit2_opts(GIT_OPT_ENABLE_CACHING, enabled)) == 0)
+			library_enable_caching = enabled;
+		return error;
+	}
+
+	if (enif_is_identical(key, atoms.library_mwindow_size)) {
+		if (!library_opt_size(&size, env, value))
+			return 1;
+		return git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, size);
+	}
+
+	if (enif_is_identical(key, atoms.library_mwindow_mapped_limit)) {
+		if (!library_opt_size(&size, env, value))
+			return 1;
+		return git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, size);
+	}
+
+#if GEEF_LIBGIT2_VERSION_CHECK(1, 1)
+	if (enif_is_identical(key, atoms.library_mwindow_file_limit)) {
+		if (!library_opt_size(&size, env, value))
+			return 1;
+		return git_libgit2_opts(GIT_OPT_SET_MWINDOW_FILE_LIMIT, size);
+	}
+#endif
+
+	if (enif_is_identical(key, atoms.library_strict_hash_verification)) {
+		if (!library_opt_bool(&enabled, value))
+			return 1;
+		if ((error = git_libgit2_opts(GIT_OPT_ENABLE_STRICT_HASH_VERIFICATION, enabled)) == 0)
+			library_strict_hash_verification = enabled;
+		return error;
+	}
+
+	if (enif_is_identical(key, atoms.library_nif_stats)) {
+		if (!library_opt_bool(&enabled, value))
+			return 1;
+		geef_stats_enable(enabled);
+		return 0;
+	}
+
+	if (enif_is_identical(key, atoms.library_async_workers)) {
+		unsigned workers;
+
+		if (!enif_get_uint(env, value, &workers) || workers == 0)
+			return 1;
+		return geef_worker_start(workers);
+	}
+
+	if (enif_is_identical(key, atoms.library_memory_soft_limit)) {
+		if (!library_opt_size(&size, env, value))
+			return 1;
+		geef_alloc_set_soft_limit(size);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Applies the options of the `opts` map. When `skip_invalid` is set, unknown, unsupported (e.g. depending on a
+ * newer libgit2) and invalid options are skipped rather than reported, the caller being expected to compare the
+ * options with geef_library_opts_get() afterwards. This is what happens when the NIF library is loaded.
+ */
+int geef_library_opts_apply(ErlNifEnv *env, ERL_NIF_TERM opts, int skip_invalid)
+{
+	ErlNifMapIterator iter;
+	ERL_NIF_TERM key, value;
+	int error = 0;
+
+	if (!enif_map_iterator_create(env, opts, &iter, ERL_NIF_MAP_ITERATOR_FIRST))
+		return 1;
+
+	while (error == 0 && enif_map_iterator_get_pair(env, &iter, &key, &value)) {
+		error = library_opt_set(env, key, value);
+		if (error > 0 && skip_invalid)
+			error = 0;
+		enif_map_iterator_next(env, &iter);
+	}
+
+	enif_map_iterator_destroy(env, &iter);
+	return error;
+}
+
+ERL_NIF_TERM
+geef_library_opts_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+
+	if (!enif_is_map(env, argv[0]))
+		return enif_make_badarg(env);
+
+	error = geef_library_opts_apply(env, argv[0], 0);
+	if (error > 0)
+		return enif_make_badarg(env);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return atoms.ok;
+}
+
+ERL_NIF_TERM
+geef_library_opts_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ssize_t cached, allowed;
+	size_t mwindow_size, mwindow_mapped_limit;
+	ERL_NIF_TERM opts, limits;
+	int error;
+
+	error = git_libgit2_opts(GIT_OPT_GET_CACHED_MEMORY, &cached, &allowed);
+	if (error == 0)
+		error = git_libgit2_opts(GIT_OPT_GET_MWINDOW_SIZE, &mwindow_size);
+	if (error == 0)
+		error = git_libgit2_opts(GIT_OPT_GET_MWINDOW_MAPPED_LIMIT, &mwindow_mapped_limit);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	opts = enif_make_new_map(env);
+	enif_make_map_put(env, opts, atoms.library_cached_memory, enif_make_int64(env, cached), &opts);
+	enif_make_map_put(env, opts, atoms.library_cache_max_size, enif_make_int64(env, allowed), &opts);
+	enif_make_map_put(env, opts, atoms.library_mwindow_size, enif_make_uint64(env, mwindow_size), &opts);
+	enif_make_map_put(env, opts, atoms.library_mwindow_mapped_limit, enif_make_uint64(env, mwindow_mapped_limit), &opts);
+	enif_make_map_put(env, opts, atoms.library_memory_soft_limit, enif_make_uint64(env, geef_alloc_soft_limit()), &opts);
+	enif_make_map_put(env, opts, atoms.library_nif_stats, geef_stats_enabled() ? atoms.true : atoms.false, &opts);
+	enif_make_map_put(env, opts, atoms.library_enable_caching, library_enable_caching ? atoms.true : atoms.false, &opts);
+	enif_make_map_put(env, opts, atoms.library_strict_hash_verification, library_strict_hash_verification ? atoms.true : atoms.false, &opts);
+	enif_make_map_put(env, opts, atoms.library_async_workers, enif_make_uint(env, geef_worker_count()), &opts);
+
+	limits = enif_make_new_map(env);
+	enif_make_map_put(env, limits, geef_object_type2atom(GIT_OBJ_COMMIT), enif_make_uint64(env, library_object_limits[GIT_OBJ_COMMIT]), &limits);
+	enif_make_map_put(env, limits, geef_object_type2atom(GIT_OBJ_TREE), enif_make_uint64(env, library_object_limits[GIT_OBJ_TREE]), &limits);
+	enif_make_map_put(env, limits, geef_object_type2atom(GIT_OBJ_BLOB), enif_make_uint64(env, library_object_limits[GIT_OBJ_BLOB]), &limits);
+	enif_make_map_put(env, limits, geef_object_type2atom(GIT_OBJ_TAG), enif_make_uint64(env, library_object_limits[GIT_OBJ_TAG]), &limits);
+	enif_make_map_put(env, opts, atoms.library_cache_object_limits, limits, &opts);
+
+#if GEEF_LIBGIT2_VERSION_CHECK(1, 1)
+	{
+		size_t mwindow_file_limit;
+
+		error = git_libgit2_opts(GIT_OPT_GET_MWINDOW_FILE_LIMIT, &mwindow_file_limit);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		enif_make_map_put(env, opts, atoms.library_mwindow_file_limit, enif_make_uint64(env, mwindow_file_limit), &opts);
+	}
+#endif
+
+	return enif_make_tuple2(env, atoms.ok, opts);
+}
@@ -1,6 +1,10 @@
 #ifndef GEEF_LIBRARY_H
 #define GEEF_LIBRARY_H
 
+int geef_library_opts_apply(ErlNifEnv *env, ERL_NIF_TERM opts, int skip_invalid);
+
 ERL_NIF_TERM geef_library_version(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_library_opts_set(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_library_opts_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
 #endif
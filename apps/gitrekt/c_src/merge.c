@@ -0,0 +1,192 @@
+#include "geef.h"
+#include "repository.h"
+#include "merge.h"
+#include "oid.h"
+#include <string.h>
+#include <git2.h>
+
+static int merge_oid_from_term(git_oid *id, ErlNifEnv *env, ERL_NIF_TERM term)
+{
+	ErlNifBinary bin;
+
+	if (!enif_inspect_binary(env, term, &bin))
+		return 0;
+
+	if (bin.size != GIT_OID_RAWSZ)
+		return 0;
+
+	git_oid_fromraw(id, bin.data);
+
+	return 1;
+}
+
+static int merge_conflicts_to_term(ERL_NIF_TERM *out, ErlNifEnv *env, git_index *index)
+{
+	int error;
+	git_index_conflict_iterator *iter;
+	const git_index_entry *ancestor, *ours, *theirs;
+	const char *path;
+	ErlNifBinary bin;
+	ERL_NIF_TERM list;
+
+	error = git_index_conflict_iterator_new(&iter, index);
+	if (error < 0)
+		return error;
+
+	list = enif_make_list(env, 0);
+	while ((error = git_index_conflict_next(&ancestor, &ours, &theirs, iter)) == 0) {
+		path = ours ? ours->path : theirs ? theirs->path : ancestor->path;
+		if (geef_string_to_bin(&bin, path) < 0) {
+			git_index_conflict_iterator_free(iter);
+			return GIT_ERROR;
+		}
+
+		list = enif_make_list_cell(env, enif_make_binary(env, &bin), list);
+	}
+
+	git_index_conflict_iterator_free(iter);
+
+	if (error != GIT_ITEROVER)
+		return error;
+
+	if (!enif_make_reverse_list(env, list, out))
+		return GIT_ERROR;
+
+	return 0;
+}
+
+static ERL_NIF_TERM merge_index_to_term(ErlNifEnv *env, git_repository *repo, git_index *index)
+{
+	int error;
+	git_oid id;
+	ErlNifBinary bin;
+	ERL_NIF_TERM conflicts;
+
+	if (git_index_has_conflicts(index)) {
+		error = merge_conflicts_to_term(&conflicts, env, index);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		return enif_make_tuple3(env, atoms.ok, atoms.nil, conflicts);
+	}
+
+	/* the resulting tree is written into the ODB, the in-memory index is never persisted */
+	error = git_index_write_tree_to(&id, index, repo);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (geef_oid_bin(&bin, &id) < 0)
+		return geef_oom(env);
+
+	return enif_make_tuple3(env, atoms.ok, enif_make_binary(env, &bin), enif_make_list(env, 0));
+}
+
+ERL_NIF_TERM
+geef_merge_trees(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	git_oid id;
+	git_tree *ancestor = NULL, *ours = NULL, *theirs = NULL;
+	git_index *index = NULL;
+	git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+	ERL_NIF_TERM term;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return geef_badarg(env);
+
+	if (enif_compare(argv[1], atoms.nil)) {
+		if (!merge_oid_from_term(&id, env, argv[1]))
+			return geef_badarg(env);
+
+		error = git_tree_lookup(&ancestor, repo->repo, &id);
+		if (error < 0)
+			return geef_error_struct(env, error);
+	}
+
+	if (!merge_oid_from_term(&id, env, argv[2])) {
+		term = geef_badarg(env);
+		goto cleanup;
+	}
+
+	error = git_tree_lookup(&ours, repo->repo, &id);
+	if (error < 0) {
+		term = geef_error_struct(env, error);
+		goto cleanup;
+	}
+
+	if (!merge_oid_from_term(&id, env, argv[3])) {
+		term = geef_badarg(env);
+		goto cleanup;
+	}
+
+	error = git_tree_lookup(&theirs, repo->repo, &id);
+	if (error < 0) {
+		term = geef_error_struct(env, error);
+		goto cleanup;
+	}
+
+	error = git_merge_trees(&index, repo->repo, ancestor, ours, theirs, &opts);
+	if (error < 0) {
+		term = geef_error_struct(env, error);
+		goto cleanup;
+	}
+
+	term = merge_index_to_term(env, repo->repo, index);
+
+cleanup:
+	git_index_free(index);
+	git_tree_free(theirs);
+	git_tree_free(ours);
+	git_tree_free(ancestor);
+
+	return term;
+}
+
+ERL_NIF_TERM
+geef_merge_commits(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	git_oid id;
+	git_commit *ours = NULL, *theirs = NULL;
+	git_index *index = NULL;
+	git_merge_options opts = GIT_MERGE_OPTIONS_INIT;
+	ERL_NIF_TERM term;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return geef_badarg(env);
+
+	if (!merge_oid_from_term(&id, env, argv[1]))
+		return geef_badarg(env);
+
+	error = git_commit_lookup(&ours, repo->repo, &id);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (!merge_oid_from_term(&id, env, argv[2])) {
+		term = geef_badarg(env);
+		goto cleanup;
+	}
+
+	error = git_commit_lookup(&theirs, repo->repo, &id);
+	if (error < 0) {
+		term = geef_error_struct(env, error);
+		goto cleanup;
+	}
+
+	error = git_merge_commits(&index, repo->repo, ours, theirs, &opts);
+	if (error < 0) {
+		term = geef_error_struct(env, error);
+		goto cleanup;
+	}
+
+	term = merge_index_to_term(env, repo->repo, index);
+
+cleanup:
+	git_index_free(index);
+	git_commit_free(theirs);
+	git_commit_free(ours);
+
+	return term;
+}
@@ -0,0 +1,7 @@
+#ifndef GEEF_MERGE_H
+#define GEEF_MERGE_H
+
+ERL_NIF_TERM geef_merge_trees(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_merge_commits(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif
@@ -3,14 +3,211 @@
 #include "object.h"
 #include "oid.h"
 #include <zlib.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <git2.h>
 
+/*
+ * Per-repository intern table of loaded objects, keyed by OID.
+ *
+ * Every object resource handed to the BEAM points to an entry of its repository's table. The entry counts the live
+ * resources sharing its git_object and is dropped together with the last one, so repeated lookups and peels of the
+ * same object return the already loaded git_object instead of going through git_object_lookup again.
+ *
+ * ERTS cannot revive a resource once its reference count has dropped to zero, so the table holds the git_object
+ * rather than the resource itself, with its own count guarded by the table lock.
+ */
+
+#define OBJECT_TABLE_INITIAL_SIZE 64
+
+typedef struct geef_object_entry {
+    struct geef_object_entry *next;
+    git_object *obj;
+    unsigned int refcount;
+} geef_object_entry;
+
+struct geef_object_table {
+    ErlNifMutex *lock;
+    geef_object_entry **buckets;
+    size_t size;
+    size_t count;
+};
+
+static size_t object_table_hash(const git_oid *id, size_t size)
+{
+    uint32_t h;
+    memcpy(&h, id->id, sizeof(h));
+    return h & (size - 1);
+}
+
+static geef_object_entry *object_table_find(struct geef_object_table *table, const git_oid *id)
+{
+    geef_object_entry *entry;
+
+    for (entry = table->buckets[object_table_hash(id, table->size)]; entry; entry = entry->next) {
+        if (git_oid_equal(git_object_id(entry->obj), id))
+            return entry;
+    }
+
+    return NULL;
+}
+
+static void object_table_grow(struct geef_object_table *table)
+{
+    size_t i, size = table->size * 2;
+    geef_object_entry **buckets, *entry, *next;
+
+    buckets = calloc(size, sizeof(geef_object_entry *));
+    if (!buckets)
+        return;
+
+    for (i = 0; i < table->size; i++) {
+        for (entry = table->buckets[i]; entry; entry = next) {
+            size_t n = object_table_hash(git_object_id(entry->obj), size);
+            next = entry->next;
+            entry->next = buckets[n];
+            buckets[n] = entry;
+        }
+    }
+
+    free(table->buckets);
+    table->buckets = buckets;
+    table->size = size;
+}
+
+struct geef_object_table *geef_object_table_new(void)
+{
+    struct geef_object_table *table;
+
+    table = calloc(1, sizeof(struct geef_object_table));
+    if (!table)
+        return NULL;
+
+    table->buckets = calloc(OBJECT_TABLE_INITIAL_SIZE, sizeof(geef_object_entry *));
+    table->lock = enif_mutex_create((char *)"geef_object_table");
+    if (!table->buckets || !table->lock) {
+        if (table->lock)
+            enif_mutex_destroy(table->lock);
+        free(table->buckets);
+        free(table);
+        return NULL;
+    }
+
+    table->size = OBJECT_TABLE_INITIAL_SIZE;
+    return table;
+}
+
+void geef_object_table_free(struct geef_object_table *table)
+{
+    if (!table)
+        return;
+
+    enif_mutex_destroy(table->lock);
+    free(table->buckets);
+    free(table);
+}
+
+int geef_object_intern(geef_object *obj, geef_repository *repo, git_object *gobj)
+{
+    struct geef_object_table *table = repo->objects;
+    geef_object_entry *entry;
+    const git_oid *id = git_object_id(gobj);
+
+    obj->obj = gobj;
+    obj->entry = NULL;
+    obj->repo = repo;
+    enif_keep_resource(repo);
+
+    if (!table)
+        return 0;
+
+    enif_mutex_lock(table->lock);
+    entry = object_table_find(table, id);
+    if (entry) {
+        entry->refcount++;
+        obj->obj = entry->obj;
+        obj->entry = entry;
+        enif_mutex_unlock(table->lock);
+        git_object_free(gobj);
+        return 0;
+    }
+
+    entry = malloc(sizeof(geef_object_entry));
+    if (entry) {
+        size_t n = object_table_hash(id, table->size);
+        entry->obj = gobj;
+        entry->refcount = 1;
+        entry->next = table->buckets[n];
+        table->buckets[n] = entry;
+        if (++table->count > table->size)
+            object_table_grow(table);
+        obj->entry = entry;
+    }
+    enif_mutex_unlock(table->lock);
+
+    return 0;
+}
+
+int geef_object_intern_lookup(geef_object *obj, geef_repository *repo, const git_oid *id, git_otype type)
+{
+    int error;
+    struct geef_object_table *table = repo->objects;
+    geef_object_entry *entry;
+    git_object *gobj;
+
+    if (table) {
+        enif_mutex_lock(table->lock);
+        entry = object_table_find(table, id);
+        if (entry && (type == GIT_OBJ_ANY || git_object_type(entry->obj) == type)) {
+            entry->refcount++;
+            enif_mutex_unlock(table->lock);
+            obj->obj = entry->obj;
+            obj->entry = entry;
+            obj->repo = repo;
+            enif_keep_resource(repo);
+            return 0;
+        }
+        enif_mutex_unlock(table->lock);
+    }
+
+    error = git_object_lookup(&gobj, repo->repo, id, type);
+    if (error < 0) {
+        obj->obj = NULL;
+        obj->entry = NULL;
+        obj->repo = repo;
+        enif_keep_resource(repo);
+        return error;
+    }
+
+    return geef_object_intern(obj, repo, gobj);
+}
+
 void geef_object_free(ErlNifEnv *env, void *cd)
 {
     geef_object *obj = (geef_object *) cd;
-    enif_release_resource(obj->repo);
+    geef_object_entry *entry = obj->entry, **link;
+    struct geef_object_table *table;
+
+    if (entry) {
+        table = obj->repo->objects;
+        enif_mutex_lock(table->lock);
+        if (--entry->refcount > 0) {
+            enif_mutex_unlock(table->lock);
+            enif_release_resource(obj->repo);
+            return;
+        }
+        link = &table->buckets[object_table_hash(git_object_id(entry->obj), table->size)];
+        while (*link != entry)
+            link = &(*link)->next;
+        *link = entry->next;
+        table->count--;
+        enif_mutex_unlock(table->lock);
+        free(entry);
+    }
+
     git_object_free(obj->obj);
+    enif_release_resource(obj->repo);
 }
 
 ERL_NIF_TERM geef_object_type2atom(const git_otype type)
@@ -88,16 +285,15 @@ geef_object_lookup(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     if (!obj)
         return geef_oom(env);
 
-    error = git_object_lookup(&obj->obj, repo->repo, &id, GIT_OBJ_ANY);
-    if (error < 0)
+    error = geef_object_intern_lookup(obj, repo, &id, GIT_OBJ_ANY);
+    if (error < 0) {
+        enif_release_resource(obj);
         return geef_error_struct(env, error);
+    }
 
     term_obj = enif_make_resource(env, obj);
     enif_release_resource(obj);
 
-    obj->repo = repo;
-    enif_keep_resource(repo);
-
     return enif_make_tuple3(env, atoms.ok, geef_object_type2atom(git_object_type(obj->obj)), term_obj);
 }
 
@@ -10,6 +10,7 @@ extern ErlNifResourceType *geef_object_type;
 typedef struct {
 	git_object *obj;
 	geef_repository *repo;
+	struct geef_object_entry *entry;
 } geef_object;
 
 ERL_NIF_TERM geef_object_repository(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
@@ -22,4 +23,9 @@ ERL_NIF_TERM geef_object_type2atom(const git_otype type);
 git_otype geef_object_atom2type(ERL_NIF_TERM term);
 void geef_object_free(ErlNifEnv *env, void *cd);
 
+struct geef_object_table *geef_object_table_new(void);
+void geef_object_table_free(struct geef_object_table *table);
+int geef_object_intern(geef_object *obj, geef_repository *repo, git_object *gobj);
+int geef_object_intern_lookup(geef_object *obj, geef_repository *repo, const git_oid *id, git_otype type);
+
 #endif
@@ -1,10 +1,157 @@
 #include "odb.h"
 #include "geef.h"
+#include "object.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <git2.h>
+#include <git2/sys/mempack.h>
+#include <git2/sys/repository.h>
 
 typedef git_transfer_progress git_indexer_progress;
 
+/*
+ * Object databases shared by the repository handles opened on the same path.
+ *
+ * A git_odb can only be used from multiple threads since libgit2 1.2, which added locking to the odb and its
+ * backends. With older versions repository_open_shared/1 falls back to a private odb per handle.
+ *
+ * Handles opened with repository_open_shared/1 keep their own git_repository (refdb, config, index and object
+ * cache, which are opened by each of them) but read objects through the same odb, with a single set of pack file
+ * maps and descriptors per repository. The odb is opened by the registry rather than borrowed from the first
+ * handle: the registry entry holds one reference, released with the last handle, and each git_repository holds
+ * its own, released by git_repository_free().
+ */
+
+typedef struct geef_odb_shared {
+	struct geef_odb_shared *next;
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	unsigned int refcount;
+	git_odb *odb;
+} geef_odb_shared;
+
+static ErlNifMutex *odb_shared_lock;
+static geef_odb_shared *odb_shared_list;
+
+int geef_odb_shared_init(void)
+{
+	odb_shared_lock = enif_mutex_create((char *)"geef_odb_shared");
+	return odb_shared_lock ? 0 : -1;
+}
+
+#if GEEF_LIBGIT2_VERSION_CHECK(1, 2)
+static geef_odb_shared *odb_shared_open(const char *path, struct stat *st)
+{
+	geef_odb_shared *shared;
+	char objects_path[MAXBUFLEN];
+	int error;
+
+	if (snprintf(objects_path, MAXBUFLEN, "%sobjects", path) >= MAXBUFLEN) {
+		giterr_set_str(GITERR_INVALID, "repository path too long");
+		return NULL;
+	}
+
+	shared = calloc(1, sizeof(geef_odb_shared));
+	if (shared == NULL || (shared->path = strdup(path)) == NULL) {
+		free(shared);
+		giterr_set_oom();
+		return NULL;
+	}
+
+	/* alternates are loaded by git_odb_open() as well */
+	error = git_odb_open(&shared->odb, objects_path);
+	if (error < 0) {
+		free(shared->path);
+		free(shared);
+		return NULL;
+	}
+
+	shared->dev = st->st_dev;
+	shared->ino = st->st_ino;
+	return shared;
+}
+#endif
+
+int geef_odb_shared_acquire(geef_repository *repo)
+{
+#if GEEF_LIBGIT2_VERSION_CHECK(1, 2)
+	geef_odb_shared *shared;
+	const char *path;
+	struct stat st;
+	int error;
+
+	path = git_repository_commondir(repo->repo);
+	if (stat(path, &st) < 0) {
+		giterr_set_str(GITERR_OS, "failed to stat repository");
+		return -1;
+	}
+
+	enif_mutex_lock(odb_shared_lock);
+	for (shared = odb_shared_list; shared; shared = shared->next) {
+		if (shared->dev == st.st_dev && shared->ino == st.st_ino && strcmp(shared->path, path) == 0)
+			break;
+	}
+
+	if (shared == NULL) {
+		if ((shared = odb_shared_open(path, &st)) == NULL) {
+			enif_mutex_unlock(odb_shared_lock);
+			return -1;
+		}
+
+		shared->next = odb_shared_list;
+		odb_shared_list = shared;
+	}
+
+	/* the repository takes a reference of its own, its private odb has not been loaded yet */
+	error = git_repository_set_odb(repo->repo, shared->odb);
+	if (error < 0) {
+		if (shared->refcount == 0) {
+			odb_shared_list = shared->next;
+			git_odb_free(shared->odb);
+			free(shared->path);
+			free(shared);
+		}
+		enif_mutex_unlock(odb_shared_lock);
+		return error;
+	}
+
+	shared->refcount++;
+	repo->odb_shared = shared;
+	enif_mutex_unlock(odb_shared_lock);
+#endif
+
+	return 0;
+}
+
+void geef_odb_shared_release(geef_odb_shared *shared)
+{
+	geef_odb_shared **link;
+
+	if (shared == NULL)
+		return;
+
+	enif_mutex_lock(odb_shared_lock);
+	if (--shared->refcount > 0) {
+		enif_mutex_unlock(odb_shared_lock);
+		return;
+	}
+
+	for (link = &odb_shared_list; *link; link = &(*link)->next) {
+		if (*link == shared) {
+			*link = shared->next;
+			break;
+		}
+	}
+	enif_mutex_unlock(odb_shared_lock);
+
+	git_odb_free(shared->odb);
+	free(shared->path);
+	free(shared);
+}
+
 void geef_odb_free(ErlNifEnv *env, void *cd)
 {
 	geef_odb *odb = (geef_odb *)cd;
@@ -17,6 +164,12 @@ void geef_odb_writepack_free(ErlNifEnv *env, void *cd)
 	git_odb_free(odb_writepack->odb_writepack);
 }
 
+void geef_mempack_free(ErlNifEnv *env, void *cd)
+{
+	geef_mempack *mempack = (geef_mempack *)cd;
+	enif_release_resource(mempack->repo);
+}
+
 static int noop_indexer_progress_callback(const git_indexer_progress *progress, void *payload)
 {
 	return 0;
@@ -321,4 +474,138 @@ geef_odb_writepack_commit(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 		return geef_error_struct(env, error);
 
         return enif_make_tuple2(env, atoms.ok, indexer_progress_to_map(env, &progress));
-}
\ No newline at end of file
+}
+
+ERL_NIF_TERM
+geef_mempack_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	char objects_path[MAXBUFLEN];
+	geef_repository *repo, *res_repo;
+	geef_mempack *mempack;
+	git_odb *odb;
+	git_odb_backend *backend;
+	git_repository *mempack_repo;
+	ERL_NIF_TERM term_repo, term_mempack;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **)&repo))
+		return enif_make_badarg(env);
+
+	if (snprintf(objects_path, MAXBUFLEN, "%sobjects", git_repository_path(repo->repo)) >= MAXBUFLEN)
+		return enif_make_badarg(env);
+
+	error = git_odb_new(&odb);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	error = git_mempack_new(&backend);
+	if (error < 0) {
+		git_odb_free(odb);
+		return geef_error_struct(env, error);
+	}
+
+	error = git_odb_add_backend(odb, backend, 1000);
+	if (error < 0) {
+		backend->free(backend);
+		git_odb_free(odb);
+		return geef_error_struct(env, error);
+	}
+
+	error = git_odb_add_disk_alternate(odb, objects_path);
+	if (error < 0) {
+		git_odb_free(odb);
+		return geef_error_struct(env, error);
+	}
+
+	error = git_repository_wrap_odb(&mempack_repo, odb);
+	git_odb_free(odb);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	res_repo = enif_alloc_resource(geef_repository_type, sizeof(geef_repository));
+	if (!res_repo) {
+		git_repository_free(mempack_repo);
+		return geef_oom(env);
+	}
+
+	res_repo->repo = mempack_repo;
+	res_repo->odb_shared = NULL;
+	res_repo->alloc_owner = NULL;
+	res_repo->objects = geef_object_table_new();
+	term_repo = enif_make_resource(env, res_repo);
+
+	mempack = enif_alloc_resource(geef_mempack_type, sizeof(geef_mempack));
+	if (!mempack) {
+		enif_release_resource(res_repo);
+		return geef_oom(env);
+	}
+
+	mempack->backend = backend;
+	mempack->repo = res_repo;
+	term_mempack = enif_make_resource(env, mempack);
+	enif_release_resource(mempack);
+
+	return enif_make_tuple3(env, atoms.ok, term_repo, term_mempack);
+}
+
+ERL_NIF_TERM
+geef_mempack_flush(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_mempack *mempack;
+	geef_repository *repo;
+	git_odb *odb;
+	git_odb_writepack *writepack;
+	git_indexer_progress progress = { 0 };
+	git_buf buf = { NULL, 0, 0 };
+
+	if (!enif_get_resource(env, argv[0], geef_mempack_type, (void **)&mempack))
+		return enif_make_badarg(env);
+
+	if (!enif_get_resource(env, argv[1], geef_repository_type, (void **)&repo))
+		return enif_make_badarg(env);
+
+	error = git_mempack_dump(&buf, mempack->repo->repo, mempack->backend);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	/* an empty pack consists of the header and the trailing checksum only */
+	if (buf.size > 12 + GIT_OID_RAWSZ) {
+		error = git_repository_odb(&odb, repo->repo);
+		if (error < 0)
+			goto cleanup;
+
+		error = git_odb_write_pack(&writepack, odb, noop_indexer_progress_callback, NULL);
+		git_odb_free(odb);
+		if (error < 0)
+			goto cleanup;
+
+		error = writepack->append(writepack, buf.ptr, buf.size, &progress);
+		if (error == 0)
+			error = writepack->commit(writepack, &progress);
+
+		writepack->free(writepack);
+	}
+
+cleanup:
+	git_buf_free(&buf);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	git_mempack_reset(mempack->backend);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_uint(env, progress.total_objects));
+}
+
+ERL_NIF_TERM
+geef_mempack_reset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_mempack *mempack;
+
+	if (!enif_get_resource(env, argv[0], geef_mempack_type, (void **)&mempack))
+		return enif_make_badarg(env);
+
+	git_mempack_reset(mempack->backend);
+
+	return atoms.ok;
+}
@@ -2,6 +2,7 @@
 #define GEEF_ODB_H
 
 #include "erl_nif.h"
+#include "repository.h"
 #include <git2.h>
 
 ERL_NIF_TERM geef_odb_hash(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
@@ -14,11 +15,21 @@ ERL_NIF_TERM geef_odb_get_writepack(ErlNifEnv *env, int argc, const ERL_NIF_TERM
 ERL_NIF_TERM geef_odb_writepack_append(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_odb_writepack_commit(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
+ERL_NIF_TERM geef_mempack_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_mempack_flush(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_mempack_reset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+int geef_odb_shared_init(void);
+int geef_odb_shared_acquire(geef_repository *repo);
+void geef_odb_shared_release(struct geef_odb_shared *shared);
+
 void geef_odb_free(ErlNifEnv *env, void *cd);
 void geef_odb_writepack_free(ErlNifEnv *env, void *cd);
+void geef_mempack_free(ErlNifEnv *env, void *cd);
 
 extern ErlNifResourceType *geef_odb_type;
 extern ErlNifResourceType *geef_odb_writepack_type;
+extern ErlNifResourceType *geef_mempack_type;
 
 typedef struct {
     git_odb *odb;
@@ -28,4 +39,9 @@ typedef struct {
     git_odb_writepack *odb_writepack;
 } geef_odb_writepack;
 
+typedef struct {
+    git_odb_backend *backend;
+    geef_repository *repo;
+} geef_mempack;
+
 #endif
@@ -18,9 +18,10 @@ geef_pathspec_match_tree(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
 	array = git_strarray_from_list(env, argv[1]);
 	if(git_pathspec_new(&pathspec, &array) < 0) {
-		git_strarray_free(&array);
+		geef_strarray_free(&array);
 		return enif_make_badarg(env);
 	}
+	geef_strarray_free(&array);
 
 	match = git_pathspec_match_tree(NULL, (git_tree *)obj->obj, GIT_PATHSPEC_NO_MATCH_ERROR, pathspec);
 
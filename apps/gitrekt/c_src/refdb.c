@@ -0,0 +1,839 @@
+#include "geef.h"
+#include "repository.h"
+#include "refdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <git2.h>
+#include <git2/sys/refdb_backend.h>
+#include <git2/sys/refs.h>
+
+/*
+ * Write-through reference cache.
+ *
+ * References are kept in a hash table shared by all the repository handles opened on the same path.
+ * Lookups are served from memory once a reference has been read from disk, listings are served from
+ * memory once the whole refs/ namespace has been loaded. Every update goes through the filesystem
+ * backend first and is reflected in the table afterwards, under the same lock, so the files on disk remain
+ * the source of truth.
+ *
+ * Only references of the refs/ namespace are cached, HEAD and the other top-level refs are always read from
+ * disk.
+ *
+ * Writers outside of this process are detected by stamping packed-refs and every directory under refs/
+ * (writing a loose ref renames a lock file, which touches its directory). When the stamp changes, the whole
+ * table is dropped and reloaded from disk. As walking refs/ costs a stat() per directory, the stamp is checked
+ * at most once every REFDB_VALIDATE_INTERVAL_MS, updates made through the cache being reflected right away.
+ */
+
+#ifdef __APPLE__
+# define REFDB_MTIME_NSEC(st) ((st)->st_mtimespec.tv_nsec)
+#else
+# define REFDB_MTIME_NSEC(st) ((st)->st_mtim.tv_nsec)
+#endif
+
+#define REFDB_VALIDATE_INTERVAL_MS 1000
+#define REFDB_STAMP_DEPTH 16
+
+typedef struct refdb_entry {
+	struct refdb_entry *next;
+	char *name;
+	char *symbolic;
+	git_oid oid;
+	git_oid peel;
+	int has_peel;
+} refdb_entry;
+
+typedef struct refdb_cache {
+	struct refdb_cache *next;
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	unsigned int refcount;
+	ErlNifMutex *lock;
+	refdb_entry **buckets;
+	size_t cap;
+	size_t count;
+	int complete;
+	uint64_t stamp;
+	ErlNifTime validated;
+} refdb_cache;
+
+typedef struct {
+	git_refdb_backend parent;
+	git_refdb_backend *fs;
+	refdb_cache *cache;
+} refdb_cached_backend;
+
+typedef struct {
+	git_reference_iterator parent;
+	refdb_entry *entries;
+	size_t count;
+	size_t pos;
+} refdb_cached_iter;
+
+static ErlNifMutex *refdb_caches_lock;
+static refdb_cache *refdb_caches;
+
+int geef_refdb_init(void)
+{
+	refdb_caches_lock = enif_mutex_create((char *)"geef_refdb_caches");
+	return refdb_caches_lock ? 0 : -1;
+}
+
+static size_t refdb_name_hash(const char *name)
+{
+	size_t hash = 2166136261u;
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+
+	return hash;
+}
+
+static int refdb_in_namespace(const char *name)
+{
+	return strncmp(name, "refs/", 5) == 0;
+}
+
+static void refdb_entry_clear(refdb_entry *entry)
+{
+	free(entry->name);
+	free(entry->symbolic);
+}
+
+static int refdb_entry_set(refdb_entry *entry, const git_reference *ref)
+{
+	const git_oid *peel;
+
+	memset(entry, 0, sizeof(refdb_entry));
+	entry->name = strdup(git_reference_name(ref));
+	if (entry->name == NULL)
+		return -1;
+
+	if (git_reference_type(ref) == GIT_REF_SYMBOLIC) {
+		entry->symbolic = strdup(git_reference_symbolic_target(ref));
+		if (entry->symbolic == NULL) {
+			free(entry->name);
+			return -1;
+		}
+	} else {
+		git_oid_cpy(&entry->oid, git_reference_target(ref));
+		peel = git_reference_target_peel(ref);
+		if (peel != NULL) {
+			git_oid_cpy(&entry->peel, peel);
+			entry->has_peel = 1;
+		}
+	}
+
+	return 0;
+}
+
+static int refdb_entry_copy(refdb_entry *dst, const refdb_entry *src)
+{
+	memcpy(dst, src, sizeof(refdb_entry));
+	dst->next = NULL;
+	dst->name = strdup(src->name);
+	dst->symbolic = src->symbolic ? strdup(src->symbolic) : NULL;
+	if (dst->name == NULL || (src->symbolic && dst->symbolic == NULL)) {
+		refdb_entry_clear(dst);
+		return -1;
+	}
+
+	return 0;
+}
+
+static git_reference *refdb_entry_to_ref(const refdb_entry *entry)
+{
+	if (entry->symbolic)
+		return git_reference__alloc_symbolic(entry->name, entry->symbolic);
+
+	return git_reference__alloc(entry->name, &entry->oid, entry->has_peel ? &entry->peel : NULL);
+}
+
+static refdb_entry **refdb_cache_slot(refdb_cache *cache, const char *name)
+{
+	refdb_entry **slot = &cache->buckets[refdb_name_hash(name) & (cache->cap - 1)];
+
+	while (*slot && strcmp((*slot)->name, name) != 0)
+		slot = &(*slot)->next;
+
+	return slot;
+}
+
+static int refdb_cache_grow(refdb_cache *cache)
+{
+	refdb_entry **buckets, *entry, *next;
+	size_t cap, i, j;
+
+	cap = cache->cap ? cache->cap * 2 : 64;
+	buckets = calloc(cap, sizeof(refdb_entry *));
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < cache->cap; i++) {
+		for (entry = cache->buckets[i]; entry; entry = next) {
+			next = entry->next;
+			j = refdb_name_hash(entry->name) & (cap - 1);
+			entry->next = buckets[j];
+			buckets[j] = entry;
+		}
+	}
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->cap = cap;
+
+	return 0;
+}
+
+static void refdb_cache_remove(refdb_cache *cache, const char *name)
+{
+	refdb_entry **slot, *entry;
+
+	slot = refdb_cache_slot(cache, name);
+	if (*slot == NULL)
+		return;
+
+	entry = *slot;
+	*slot = entry->next;
+	refdb_entry_clear(entry);
+	free(entry);
+	cache->count--;
+}
+
+static int refdb_cache_put(refdb_cache *cache, const git_reference *ref)
+{
+	refdb_entry **slot, *entry;
+
+	if (!refdb_in_namespace(git_reference_name(ref)))
+		return 0;
+
+	if (cache->count >= cache->cap && refdb_cache_grow(cache) < 0)
+		return -1;
+
+	entry = malloc(sizeof(refdb_entry));
+	if (entry == NULL)
+		return -1;
+
+	if (refdb_entry_set(entry, ref) < 0) {
+		free(entry);
+		return -1;
+	}
+
+	slot = refdb_cache_slot(cache, entry->name);
+	if (*slot) {
+		entry->next = (*slot)->next;
+		refdb_entry_clear(*slot);
+		free(*slot);
+		cache->count--;
+	}
+
+	*slot = entry;
+	cache->count++;
+
+	return 0;
+}
+
+/* when the outcome of an update is unknown, the entry is dropped and the next listing reloads refs from disk */
+static void refdb_cache_forget(refdb_cache *cache, const char *name)
+{
+	refdb_cache_remove(cache, name);
+	cache->complete = 0;
+}
+
+static void refdb_cache_clear(refdb_cache *cache)
+{
+	refdb_entry *entry, *next;
+	size_t i;
+
+	for (i = 0; i < cache->cap; i++) {
+		for (entry = cache->buckets[i]; entry; entry = next) {
+			next = entry->next;
+			refdb_entry_clear(entry);
+			free(entry);
+		}
+		cache->buckets[i] = NULL;
+	}
+
+	cache->count = 0;
+	cache->complete = 0;
+}
+
+static uint64_t refdb_stamp_fold(uint64_t stamp, const struct stat *st)
+{
+	uint64_t values[4] = { st->st_ino, st->st_size, st->st_mtime, REFDB_MTIME_NSEC(st) };
+	size_t i;
+
+	for (i = 0; i < 4; i++)
+		stamp = (stamp ^ values[i]) * 1099511628211u;
+
+	return stamp;
+}
+
+/* folds the stat of `path` and, when it is a directory, of all its subdirectories into `stamp` */
+static uint64_t refdb_stamp_dir(uint64_t stamp, char *path, size_t len, int depth)
+{
+	struct dirent *ent;
+	struct stat st;
+	DIR *dir;
+	int is_dir;
+
+	if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode))
+		return stamp;
+
+	stamp = refdb_stamp_fold(stamp, &st);
+	if (depth >= REFDB_STAMP_DEPTH || (dir = opendir(path)) == NULL)
+		return stamp;
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (ent->d_name[0] == '.')
+			continue;
+
+#ifdef DT_DIR
+		if (ent->d_type != DT_DIR && ent->d_type != DT_UNKNOWN)
+			continue;
+#endif
+		if (snprintf(path + len, MAXBUFLEN - len, "/%s", ent->d_name) >= (int)(MAXBUFLEN - len))
+			continue;
+
+		is_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+		if (is_dir)
+			stamp = refdb_stamp_dir(stamp, path, len + 1 + strlen(ent->d_name), depth + 1);
+	}
+
+	closedir(dir);
+	path[len] = '\0';
+
+	return stamp;
+}
+
+static uint64_t refdb_cache_stamp(const char *path)
+{
+	char stamp_path[MAXBUFLEN];
+	uint64_t stamp = 14695981039346656037u;
+	struct stat st;
+	int len;
+
+	if (snprintf(stamp_path, MAXBUFLEN, "%spacked-refs", path) < MAXBUFLEN && stat(stamp_path, &st) == 0)
+		stamp = refdb_stamp_fold(stamp, &st);
+
+	len = snprintf(stamp_path, MAXBUFLEN, "%srefs", path);
+	if (len < MAXBUFLEN)
+		stamp = refdb_stamp_dir(stamp, stamp_path, len, 0);
+
+	return stamp;
+}
+
+/*
+ * Drops the table when the refs on disk have been changed by someone else since it was filled. Updates `force`
+ * the check, as the stamp taken after them would otherwise hide external changes made in the meantime.
+ */
+static void refdb_cache_validate(refdb_cache *cache, int force)
+{
+	ErlNifTime now = enif_monotonic_time(ERL_NIF_MSEC);
+	uint64_t stamp;
+
+	if (!force && now - cache->validated < REFDB_VALIDATE_INTERVAL_MS)
+		return;
+
+	cache->validated = now;
+	stamp = refdb_cache_stamp(cache->path);
+	if (stamp == cache->stamp)
+		return;
+
+	refdb_cache_clear(cache);
+	cache->stamp = stamp;
+}
+
+/* our own updates touch the stamped files too, they must not be mistaken for external ones */
+static void refdb_cache_restamp(refdb_cache *cache)
+{
+	cache->stamp = refdb_cache_stamp(cache->path);
+	cache->validated = enif_monotonic_time(ERL_NIF_MSEC);
+}
+
+static int refdb_cache_load(refdb_cache *cache, git_refdb_backend *fs)
+{
+	git_reference_iterator *iter;
+	git_reference *ref;
+	int error;
+
+	error = fs->iterator(&iter, fs, NULL);
+	if (error < 0)
+		return error;
+
+	while ((error = iter->next(&ref, iter)) == 0) {
+		error = refdb_cache_put(cache, ref);
+		git_reference_free(ref);
+		if (error < 0)
+			break;
+	}
+
+	iter->free(iter);
+
+	if (error != GIT_ITEROVER)
+		return error;
+
+	cache->complete = 1;
+	return 0;
+}
+
+static refdb_cache *refdb_cache_acquire(const char *path)
+{
+	refdb_cache *cache;
+	struct stat st;
+
+	/* the inode tells a repository apart from one re-created at the same path */
+	if (stat(path, &st) < 0)
+		return NULL;
+
+	enif_mutex_lock(refdb_caches_lock);
+	for (cache = refdb_caches; cache; cache = cache->next) {
+		if (cache->dev == st.st_dev && cache->ino == st.st_ino && strcmp(cache->path, path) == 0) {
+			cache->refcount++;
+			enif_mutex_unlock(refdb_caches_lock);
+			return cache;
+		}
+	}
+
+	cache = calloc(1, sizeof(refdb_cache));
+	if (cache == NULL)
+		goto on_error;
+
+	cache->path = strdup(path);
+	cache->lock = enif_mutex_create((char *)"geef_refdb_cache");
+	if (cache->path == NULL || cache->lock == NULL || refdb_cache_grow(cache) < 0)
+		goto on_error;
+
+	cache->dev = st.st_dev;
+	cache->ino = st.st_ino;
+	cache->refcount = 1;
+	refdb_cache_restamp(cache);
+	cache->next = refdb_caches;
+	refdb_caches = cache;
+	enif_mutex_unlock(refdb_caches_lock);
+
+	return cache;
+
+on_error:
+	if (cache) {
+		if (cache->lock)
+			enif_mutex_destroy(cache->lock);
+		free(cache->path);
+		free(cache);
+	}
+	enif_mutex_unlock(refdb_caches_lock);
+	return NULL;
+}
+
+static void refdb_cache_release(refdb_cache *cache)
+{
+	refdb_cache **link;
+
+	enif_mutex_lock(refdb_caches_lock);
+	if (--cache->refcount > 0) {
+		enif_mutex_unlock(refdb_caches_lock);
+		return;
+	}
+
+	for (link = &refdb_caches; *link; link = &(*link)->next) {
+		if (*link == cache) {
+			*link = cache->next;
+			break;
+		}
+	}
+	enif_mutex_unlock(refdb_caches_lock);
+
+	refdb_cache_clear(cache);
+	enif_mutex_destroy(cache->lock);
+	free(cache->buckets);
+	free(cache->path);
+	free(cache);
+}
+
+static int refdb_cached_exists(int *exists, git_refdb_backend *_backend, const char *ref_name)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	refdb_cache *cache = backend->cache;
+	int error;
+
+	enif_mutex_lock(cache->lock);
+	refdb_cache_validate(cache, 0);
+	if (*refdb_cache_slot(cache, ref_name)) {
+		*exists = 1;
+		error = 0;
+	} else if (cache->complete && refdb_in_namespace(ref_name)) {
+		*exists = 0;
+		error = 0;
+	} else {
+		error = backend->fs->exists(exists, backend->fs, ref_name);
+	}
+	enif_mutex_unlock(cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_lookup(git_reference **out, git_refdb_backend *_backend, const char *ref_name)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	refdb_cache *cache = backend->cache;
+	refdb_entry *entry;
+	int error;
+
+	/* misses are resolved under the lock so that a concurrent update cannot be overwritten by a stale read */
+	enif_mutex_lock(cache->lock);
+	refdb_cache_validate(cache, 0);
+	entry = *refdb_cache_slot(cache, ref_name);
+	if (entry) {
+		*out = refdb_entry_to_ref(entry);
+		error = *out ? 0 : -1;
+	} else if (cache->complete && refdb_in_namespace(ref_name)) {
+		giterr_set_str(GITERR_REFERENCE, "reference not found");
+		error = GIT_ENOTFOUND;
+	} else {
+		error = backend->fs->lookup(out, backend->fs, ref_name);
+		if (error == 0)
+			refdb_cache_put(cache, *out);
+	}
+	enif_mutex_unlock(cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_iterator_next(git_reference **ref, git_reference_iterator *_iter)
+{
+	refdb_cached_iter *iter = (refdb_cached_iter *)_iter;
+
+	if (iter->pos >= iter->count)
+		return GIT_ITEROVER;
+
+	*ref = refdb_entry_to_ref(&iter->entries[iter->pos++]);
+	return *ref ? 0 : -1;
+}
+
+static int refdb_cached_iterator_next_name(const char **ref_name, git_reference_iterator *_iter)
+{
+	refdb_cached_iter *iter = (refdb_cached_iter *)_iter;
+
+	if (iter->pos >= iter->count)
+		return GIT_ITEROVER;
+
+	*ref_name = iter->entries[iter->pos++].name;
+	return 0;
+}
+
+static void refdb_cached_iterator_free(git_reference_iterator *_iter)
+{
+	refdb_cached_iter *iter = (refdb_cached_iter *)_iter;
+	size_t i;
+
+	for (i = 0; i < iter->count; i++)
+		refdb_entry_clear(&iter->entries[i]);
+
+	free(iter->entries);
+	free(iter);
+}
+
+static int refdb_entry_cmp(const void *a, const void *b)
+{
+	return strcmp(((const refdb_entry *)a)->name, ((const refdb_entry *)b)->name);
+}
+
+static int refdb_cached_iterator(git_reference_iterator **out, git_refdb_backend *_backend, const char *glob)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	refdb_cache *cache = backend->cache;
+	refdb_cached_iter *iter;
+	refdb_entry *entry;
+	size_t i;
+	int error = 0;
+
+	iter = calloc(1, sizeof(refdb_cached_iter));
+	if (iter == NULL)
+		return -1;
+
+	enif_mutex_lock(cache->lock);
+	refdb_cache_validate(cache, 0);
+	if (!cache->complete)
+		error = refdb_cache_load(cache, backend->fs);
+
+	if (error == 0) {
+		/* entries are copied so that the iterator does not hold the lock */
+		iter->entries = calloc(cache->count ? cache->count : 1, sizeof(refdb_entry));
+		if (iter->entries == NULL)
+			error = -1;
+	}
+
+	for (i = 0; i < cache->cap && error == 0; i++) {
+		for (entry = cache->buckets[i]; entry && error == 0; entry = entry->next) {
+			if (!refdb_in_namespace(entry->name))
+				continue;
+
+			if (glob && fnmatch(glob, entry->name, 0) != 0)
+				continue;
+
+			error = refdb_entry_copy(&iter->entries[iter->count], entry);
+			if (error == 0)
+				iter->count++;
+		}
+	}
+	enif_mutex_unlock(cache->lock);
+
+	if (error < 0) {
+		refdb_cached_iterator_free(&iter->parent);
+		return error;
+	}
+
+	qsort(iter->entries, iter->count, sizeof(refdb_entry), refdb_entry_cmp);
+
+	iter->parent.next = refdb_cached_iterator_next;
+	iter->parent.next_name = refdb_cached_iterator_next_name;
+	iter->parent.free = refdb_cached_iterator_free;
+
+	*out = &iter->parent;
+	return 0;
+}
+
+static int refdb_cached_write(git_refdb_backend *_backend, const git_reference *ref, int force, const git_signature *who, const char *message, const git_oid *old, const char *old_target)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	int error;
+
+	/* the lock is held across the write so that concurrent writers update the table in the order they hit the disk */
+	enif_mutex_lock(backend->cache->lock);
+	refdb_cache_validate(backend->cache, 1);
+	error = backend->fs->write(backend->fs, ref, force, who, message, old, old_target);
+	if (error < 0 || refdb_cache_put(backend->cache, ref) < 0)
+		refdb_cache_forget(backend->cache, git_reference_name(ref));
+	refdb_cache_restamp(backend->cache);
+	enif_mutex_unlock(backend->cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_rename(git_reference **out, git_refdb_backend *_backend, const char *old_name, const char *new_name, int force, const git_signature *who, const char *message)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	int error;
+
+	enif_mutex_lock(backend->cache->lock);
+	refdb_cache_validate(backend->cache, 1);
+	error = backend->fs->rename(out, backend->fs, old_name, new_name, force, who, message);
+	if (error < 0) {
+		refdb_cache_forget(backend->cache, old_name);
+		refdb_cache_forget(backend->cache, new_name);
+	} else {
+		refdb_cache_remove(backend->cache, old_name);
+		if (refdb_cache_put(backend->cache, *out) < 0)
+			refdb_cache_forget(backend->cache, new_name);
+	}
+	refdb_cache_restamp(backend->cache);
+	enif_mutex_unlock(backend->cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_del(git_refdb_backend *_backend, const char *ref_name, const git_oid *old_id, const char *old_target)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	int error;
+
+	enif_mutex_lock(backend->cache->lock);
+	refdb_cache_validate(backend->cache, 1);
+	error = backend->fs->del(backend->fs, ref_name, old_id, old_target);
+	if (error < 0)
+		refdb_cache_forget(backend->cache, ref_name);
+	else
+		refdb_cache_remove(backend->cache, ref_name);
+	refdb_cache_restamp(backend->cache);
+	enif_mutex_unlock(backend->cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_compress(git_refdb_backend *_backend)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	int error;
+
+	/* packing moves refs around without changing their values */
+	enif_mutex_lock(backend->cache->lock);
+	refdb_cache_validate(backend->cache, 1);
+	error = backend->fs->compress(backend->fs);
+	refdb_cache_restamp(backend->cache);
+	enif_mutex_unlock(backend->cache->lock);
+
+	return error;
+}
+
+static int refdb_cached_has_log(git_refdb_backend *_backend, const char *refname)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->has_log(backend->fs, refname);
+}
+
+static int refdb_cached_ensure_log(git_refdb_backend *_backend, const char *refname)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->ensure_log(backend->fs, refname);
+}
+
+static int refdb_cached_reflog_read(git_reflog **out, git_refdb_backend *_backend, const char *name)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->reflog_read(out, backend->fs, name);
+}
+
+static int refdb_cached_reflog_write(git_refdb_backend *_backend, git_reflog *reflog)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->reflog_write(backend->fs, reflog);
+}
+
+static int refdb_cached_reflog_rename(git_refdb_backend *_backend, const char *old_name, const char *new_name)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->reflog_rename(backend->fs, old_name, new_name);
+}
+
+static int refdb_cached_reflog_delete(git_refdb_backend *_backend, const char *name)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->reflog_delete(backend->fs, name);
+}
+
+static int refdb_cached_lock(void **payload_out, git_refdb_backend *_backend, const char *refname)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	return backend->fs->lock(payload_out, backend->fs, refname);
+}
+
+static int refdb_cached_unlock(git_refdb_backend *_backend, void *payload, int success, int update_reflog, const git_reference *ref, const git_signature *sig, const char *message)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+	int error;
+
+	if (!success || ref == NULL)
+		return backend->fs->unlock(backend->fs, payload, success, update_reflog, ref, sig, message);
+
+	/* success is 1 when the reference has been written and 2 when it has been removed */
+	enif_mutex_lock(backend->cache->lock);
+	refdb_cache_validate(backend->cache, 1);
+	error = backend->fs->unlock(backend->fs, payload, success, update_reflog, ref, sig, message);
+	if (error < 0)
+		refdb_cache_forget(backend->cache, git_reference_name(ref));
+	else if (success == 2)
+		refdb_cache_remove(backend->cache, git_reference_name(ref));
+	else if (refdb_cache_put(backend->cache, ref) < 0)
+		refdb_cache_forget(backend->cache, git_reference_name(ref));
+	refdb_cache_restamp(backend->cache);
+	enif_mutex_unlock(backend->cache->lock);
+
+	return error;
+}
+
+static void refdb_cached_free(git_refdb_backend *_backend)
+{
+	refdb_cached_backend *backend = (refdb_cached_backend *)_backend;
+
+	backend->fs->free(backend->fs);
+	refdb_cache_release(backend->cache);
+	free(backend);
+}
+
+ERL_NIF_TERM
+geef_refdb_compress(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_repository *repo;
+	git_refdb *refdb;
+	int error;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	error = git_repository_refdb(&refdb, repo->repo);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	/* packs all loose refs into packed-refs and removes the loose files */
+	error = git_refdb_compress(refdb);
+	git_refdb_free(refdb);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return atoms.ok;
+}
+
+ERL_NIF_TERM
+geef_refdb_cache_enable(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_repository *repo;
+	refdb_cached_backend *backend;
+	git_refdb *refdb;
+	int error;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	backend = calloc(1, sizeof(refdb_cached_backend));
+	if (backend == NULL)
+		return geef_oom(env);
+
+	error = git_refdb_init_backend(&backend->parent, GIT_REFDB_BACKEND_VERSION);
+	if (error < 0) {
+		free(backend);
+		return geef_error_struct(env, error);
+	}
+
+	error = git_refdb_backend_fs(&backend->fs, repo->repo);
+	if (error < 0) {
+		free(backend);
+		return geef_error_struct(env, error);
+	}
+
+	backend->cache = refdb_cache_acquire(git_repository_path(repo->repo));
+	if (backend->cache == NULL) {
+		backend->fs->free(backend->fs);
+		free(backend);
+		return geef_oom(env);
+	}
+
+	backend->parent.exists = refdb_cached_exists;
+	backend->parent.lookup = refdb_cached_lookup;
+	backend->parent.iterator = refdb_cached_iterator;
+	backend->parent.write = refdb_cached_write;
+	backend->parent.rename = refdb_cached_rename;
+	backend->parent.del = refdb_cached_del;
+	backend->parent.compress = refdb_cached_compress;
+	backend->parent.has_log = refdb_cached_has_log;
+	backend->parent.ensure_log = refdb_cached_ensure_log;
+	backend->parent.free = refdb_cached_free;
+	backend->parent.reflog_read = refdb_cached_reflog_read;
+	backend->parent.reflog_write = refdb_cached_reflog_write;
+	backend->parent.reflog_rename = refdb_cached_reflog_rename;
+	backend->parent.reflog_delete = refdb_cached_reflog_delete;
+	backend->parent.lock = refdb_cached_lock;
+	backend->parent.unlock = refdb_cached_unlock;
+
+	error = git_repository_refdb(&refdb, repo->repo);
+	if (error < 0) {
+		refdb_cached_free(&backend->parent);
+		return geef_error_struct(env, error);
+	}
+
+	/* on success the refdb takes ownership of the backend */
+	error = git_refdb_set_backend(refdb, &backend->parent);
+	git_refdb_free(refdb);
+
+	if (error < 0) {
+		refdb_cached_free(&backend->parent);
+		return geef_error_struct(env, error);
+	}
+
+	return atoms.ok;
+}
@@ -0,0 +1,9 @@
+#ifndef GEEF_REFDB_H
+#define GEEF_REFDB_H
+
+int geef_refdb_init(void);
+
+ERL_NIF_TERM geef_refdb_compress(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_refdb_cache_enable(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif
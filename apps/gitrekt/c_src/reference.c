@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include <git2.h>
 
@@ -131,10 +132,11 @@ ERL_NIF_TERM
 geef_reference_peel(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
 	geef_repository *repo;
-	git_reference *ref;
+	git_reference *ref, *resolved;
 	ErlNifBinary id, bin;
-	git_otype type;
-	geef_object *peeled;
+	git_otype type, target_type;
+	git_object *obj;
+	geef_object *target, *peeled;
 	ERL_NIF_TERM term_peeled;
 	int error;
 
@@ -156,28 +158,48 @@ geef_reference_peel(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (error < 0)
 		return geef_error_struct(env, error);
 
-	peeled = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-	if (!peeled)
-		return geef_oom(env);
-
-	error = git_reference_peel(&peeled->obj, ref, type);
+	error = git_reference_resolve(&resolved, ref);
+	git_reference_free(ref);
 	if (error < 0)
 		return geef_error_struct(env, error);
 
-	if (geef_oid_bin(&id, git_object_id(peeled->obj)) < 0) {
-		enif_release_resource(peeled);
+	target = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!target) {
+		git_reference_free(resolved);
 		return geef_oom(env);
 	}
 
-	peeled->repo = repo;
-	enif_keep_resource(peeled->repo);
+	/* the direct target is usually the object asked for, and often already interned */
+	error = geef_object_intern_lookup(target, repo, git_reference_target(resolved), GIT_OBJ_ANY);
+	git_reference_free(resolved);
+	if (error < 0) {
+		enif_release_resource(target);
+		return geef_error_struct(env, error);
+	}
+
+	target_type = git_object_type(target->obj);
+	if (target_type == type || (type == GIT_OBJ_ANY && target_type != GIT_OBJ_TAG)) {
+		peeled = target;
+	} else {
+		error = git_object_peel(&obj, target->obj, type);
+		enif_release_resource(target);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		peeled = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+		if (!peeled) {
+			git_object_free(obj);
+			return geef_oom(env);
+		}
+
+		geef_object_intern(peeled, repo, obj);
+	}
 
 	term_peeled = enif_make_resource(env, peeled);
 	enif_release_resource(peeled);
 
-	git_reference_free(ref);
-	if (error < 0)
-		return geef_error_struct(env, error);
+	if (geef_oid_bin(&id, git_object_id(peeled->obj)) < 0)
+		return geef_oom(env);
 
 	return enif_make_tuple4(env, atoms.ok, geef_object_type2atom(git_object_type(peeled->obj)),
 				enif_make_binary(env, &id), term_peeled);
@@ -308,6 +330,115 @@ geef_reference_next(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	return enif_make_tuple5(env, atoms.ok, enif_make_binary(env, &bin), shorthand, type, target);
 }
 
+/* Peels annotated tags to their target, `peeled_type` is the type of that object or nil */
+static int ref_peeled(ERL_NIF_TERM *out, ERL_NIF_TERM *peeled_type, ErlNifEnv *env, git_odb *odb, git_reference *ref)
+{
+	int error;
+	size_t len;
+	git_otype type;
+	git_object *peeled;
+	ErlNifBinary bin;
+
+	*out = atoms.nil;
+	*peeled_type = atoms.nil;
+	if (git_reference_type(ref) != GIT_REF_OID)
+		return 0;
+
+	/* reading the object header is enough to tell annotated tags apart without inflating anything */
+	error = git_odb_read_header(&len, &type, odb, git_reference_target(ref));
+	if (error < 0 || type != GIT_OBJ_TAG)
+		return 0;
+
+	error = git_reference_peel(&peeled, ref, GIT_OBJ_ANY);
+	if (error < 0)
+		return 0;
+
+	error = geef_oid_bin(&bin, git_object_id(peeled));
+	type = git_object_type(peeled);
+	git_object_free(peeled);
+	if (error < 0)
+		return -1;
+
+	*out = enif_make_binary(env, &bin);
+	*peeled_type = geef_object_type2atom(type);
+	return 0;
+}
+
+ERL_NIF_TERM
+geef_reference_list_full(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	size_t len;
+	const char *name;
+	geef_repository *repo;
+	ErlNifBinary bin;
+	git_odb *odb;
+	git_reference *ref;
+	git_reference_iterator *iter;
+	ERL_NIF_TERM list, type, target, shorthand, peeled, peeled_type;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (enif_is_identical(argv[1], atoms.undefined)) {
+		error = git_reference_iterator_new(&iter, repo->repo);
+	} else if (enif_inspect_binary(env, argv[1], &bin)) {
+		if (!geef_terminate_binary(&bin))
+			return geef_oom(env);
+
+		error = git_reference_iterator_glob_new(&iter, repo->repo, (char *) bin.data);
+		enif_release_binary(&bin);
+	} else {
+		return enif_make_badarg(env);
+	}
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	error = git_repository_odb(&odb, repo->repo);
+	if (error < 0) {
+		git_reference_iterator_free(iter);
+		return geef_error_struct(env, error);
+	}
+
+	list = enif_make_list(env, 0);
+	while ((error = git_reference_next(&ref, iter)) == 0) {
+		type = ref_type(ref);
+		if (ref_target(&target, env, ref) < 0 ||
+		    ref_shorthand(&shorthand, env, ref) < 0 ||
+		    ref_peeled(&peeled, &peeled_type, env, odb, ref) < 0)
+			goto on_oom;
+
+		name = git_reference_name(ref);
+		len = strlen(name);
+		if (!enif_alloc_binary(len, &bin))
+			goto on_oom;
+
+		memcpy(bin.data, name, len);
+		git_reference_free(ref);
+
+		list = enif_make_list_cell(env, enif_make_tuple6(env, enif_make_binary(env, &bin), shorthand, type, target, peeled, peeled_type), list);
+	}
+
+	git_odb_free(odb);
+	git_reference_iterator_free(iter);
+
+	if (error != GIT_ITEROVER)
+		return geef_error_struct(env, error);
+
+	if (!enif_make_reverse_list(env, list, &list))
+		return geef_oom(env);
+
+	return enif_make_tuple2(env, atoms.ok, list);
+
+on_oom:
+	git_reference_free(ref);
+	git_odb_free(odb);
+	git_reference_iterator_free(iter);
+
+	return geef_oom(env);
+}
+
 void geef_ref_iter_free(ErlNifEnv *env, void *cd)
 {
 	geef_ref_iter *ref = (geef_ref_iter *) cd;
@@ -548,6 +679,148 @@ geef_reference_delete(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 }
 
 
+typedef struct {
+	char *name;
+	git_oid old_id;
+	git_oid new_id;
+	int has_old;
+	int has_new;
+} geef_ref_update;
+
+static void ref_updates_free(geef_ref_update *updates, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++)
+		free(updates[i].name);
+
+	free(updates);
+}
+
+static int ref_update_oid(git_oid *out, int *set, ErlNifEnv *env, ERL_NIF_TERM term)
+{
+	ErlNifBinary bin;
+
+	if (enif_is_identical(term, atoms.nil)) {
+		*set = 0;
+		return 1;
+	}
+
+	if (!enif_inspect_binary(env, term, &bin) || bin.size != GIT_OID_RAWSZ)
+		return 0;
+
+	git_oid_fromraw(out, bin.data);
+	*set = 1;
+	return 1;
+}
+
+static int ref_updates_from_list(geef_ref_update **out, unsigned int *count, ErlNifEnv *env, ERL_NIF_TERM list)
+{
+	ERL_NIF_TERM head, tail;
+	const ERL_NIF_TERM *tuple;
+	geef_ref_update *updates;
+	ErlNifBinary name;
+	unsigned int i;
+	int arity;
+
+	if (!enif_get_list_length(env, list, count))
+		return 0;
+
+	updates = calloc(*count ? *count : 1, sizeof(geef_ref_update));
+	if (updates == NULL)
+		return 0;
+
+	tail = list;
+	for (i = 0; i < *count; i++) {
+		if (!enif_get_list_cell(env, tail, &head, &tail) ||
+		    !enif_get_tuple(env, head, &arity, &tuple) || arity != 3 ||
+		    !enif_inspect_binary(env, tuple[0], &name) ||
+		    !ref_update_oid(&updates[i].old_id, &updates[i].has_old, env, tuple[1]) ||
+		    !ref_update_oid(&updates[i].new_id, &updates[i].has_new, env, tuple[2]))
+			goto on_error;
+
+		updates[i].name = calloc(name.size + 1, sizeof(char));
+		if (updates[i].name == NULL)
+			goto on_error;
+
+		memcpy(updates[i].name, name.data, name.size);
+	}
+
+	*out = updates;
+	return 1;
+
+on_error:
+	ref_updates_free(updates, *count);
+	return 0;
+}
+
+/* refs are locked at this point, so the current value cannot change under our feet */
+static int ref_update_check(git_repository *repo, geef_ref_update *update)
+{
+	git_oid id;
+	int error;
+
+	error = git_reference_name_to_id(&id, repo, update->name);
+	if (error == GIT_ENOTFOUND && !update->has_old)
+		return 0;
+
+	if (error < 0 && error != GIT_ENOTFOUND)
+		return error;
+
+	if (error == 0 && update->has_old && git_oid_equal(&id, &update->old_id))
+		return 0;
+
+	giterr_set_str(GITERR_REFERENCE, "reference has been modified concurrently");
+	return GIT_EMODIFIED;
+}
+
+ERL_NIF_TERM
+geef_reference_transaction(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_repository *repo;
+	geef_ref_update *updates;
+	git_transaction *tx;
+	unsigned int count, i;
+	int error;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!ref_updates_from_list(&updates, &count, env, argv[1]))
+		return enif_make_badarg(env);
+
+	error = git_transaction_new(&tx, repo->repo);
+	if (error < 0) {
+		ref_updates_free(updates, count);
+		return geef_error_struct(env, error);
+	}
+
+	for (i = 0; i < count && error == 0; i++)
+		error = git_transaction_lock_ref(tx, updates[i].name);
+
+	for (i = 0; i < count && error == 0; i++)
+		error = ref_update_check(repo->repo, &updates[i]);
+
+	for (i = 0; i < count && error == 0; i++) {
+		if (updates[i].has_new)
+			error = git_transaction_set_target(tx, updates[i].name, &updates[i].new_id, NULL, NULL);
+		else
+			error = git_transaction_remove(tx, updates[i].name);
+	}
+
+	if (error == 0)
+		error = git_transaction_commit(tx);
+
+	/* freeing the transaction releases all the locks it still holds */
+	git_transaction_free(tx);
+	ref_updates_free(updates, count);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return atoms.ok;
+}
+
 ERL_NIF_TERM
 geef_reference_has_log(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -5,6 +5,7 @@
 #include "config.h"
 #include "index.h"
 #include "geef.h"
+#include "alloc.h"
 #include <string.h>
 #include <git2.h>
 
@@ -12,6 +13,9 @@ void geef_repository_free(ErlNifEnv *env, void *cd)
 {
 	geef_repository *grepo = (geef_repository *)cd;
 	git_repository_free(grepo->repo);
+	geef_odb_shared_release(grepo->odb_shared);
+	geef_object_table_free(grepo->objects);
+	geef_alloc_owner_release(grepo->alloc_owner);
 }
 
 ERL_NIF_TERM
@@ -51,6 +55,9 @@ geef_repository_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
 	res_repo = enif_alloc_resource(geef_repository_type, sizeof(geef_repository));
 	res_repo->repo = repo;
+	res_repo->odb_shared = NULL;
+	res_repo->alloc_owner = NULL;
+	res_repo->objects = geef_object_table_new();
 	term_repo = enif_make_resource(env, res_repo);
 	enif_release_resource(res_repo);
 
@@ -78,12 +85,49 @@ geef_repository_open(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
 	res_repo = enif_alloc_resource(geef_repository_type, sizeof(geef_repository));
 	res_repo->repo = repo;
+	res_repo->odb_shared = NULL;
+	res_repo->alloc_owner = NULL;
+	res_repo->objects = geef_object_table_new();
 	term_repo = enif_make_resource(env, res_repo);
 	enif_release_resource(res_repo);
 
 	return enif_make_tuple2(env, atoms.ok, term_repo);
 }
 
+ERL_NIF_TERM
+geef_repository_open_shared(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	git_repository *repo;
+	geef_repository *res_repo;
+	ErlNifBinary bin;
+	ERL_NIF_TERM term_repo;
+
+	if (!enif_inspect_binary(env, argv[0], &bin))
+		return enif_make_badarg(env);
+
+	if (!geef_terminate_binary(&bin))
+		return geef_oom(env);
+
+	error = git_repository_open(&repo, (char *)bin.data);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	res_repo = enif_alloc_resource(geef_repository_type, sizeof(geef_repository));
+	res_repo->repo = repo;
+	res_repo->odb_shared = NULL;
+	res_repo->alloc_owner = NULL;
+	res_repo->objects = geef_object_table_new();
+	term_repo = enif_make_resource(env, res_repo);
+	enif_release_resource(res_repo);
+
+	error = geef_odb_shared_acquire(res_repo);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	return enif_make_tuple2(env, atoms.ok, term_repo);
+}
+
 ERL_NIF_TERM
 geef_repository_discover(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -8,6 +8,7 @@
 
 ERL_NIF_TERM geef_repository_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_repository_open(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_repository_open_shared(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_repository_discover(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_repository_path(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_repository_workdir(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
@@ -23,6 +24,9 @@ extern ErlNifResourceType *geef_repository_type;
 
 typedef struct {
     git_repository *repo;
+    struct geef_odb_shared *odb_shared;
+    struct geef_object_table *objects;
+    struct geef_alloc_owner *alloc_owner;
 } geef_repository;
 
 #endif
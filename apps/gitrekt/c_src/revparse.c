@@ -13,6 +13,7 @@ geef_revparse_single(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	ErlNifBinary bin, id;
 	geef_repository *repo;
 	geef_object *obj;
+	git_object *parsed;
 	ERL_NIF_TERM type, term_obj;
 
 	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
@@ -24,16 +25,20 @@ geef_revparse_single(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (geef_terminate_binary(&bin) < 0)
 		return geef_oom(env);
 
-	obj = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-	if (!obj)
-		return geef_oom(env);
-
-	error = git_revparse_single(&obj->obj, repo->repo, (char *) bin.data);
+	error = git_revparse_single(&parsed, repo->repo, (char *) bin.data);
 	if (error < 0) {
 		enif_release_binary(&bin);
 		return geef_error_struct(env, error);
 	}
 
+	obj = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!obj) {
+		git_object_free(parsed);
+		return geef_oom(env);
+	}
+
+	geef_object_intern(obj, repo, parsed);
+
 	type = geef_object_type2atom(git_object_type(obj->obj));
 
 	if (geef_oid_bin(&id, git_object_id(obj->obj)) < 0)
@@ -43,9 +48,6 @@ geef_revparse_single(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	term_obj = enif_make_resource(env, obj);
 	enif_release_resource(obj);
 
-	obj->repo = repo;
-	enif_keep_resource(repo);
-
 	return enif_make_tuple4(env, atoms.ok, term_obj, type, enif_make_binary(env, &id));
 }
 
@@ -60,6 +62,7 @@ geef_revparse_ext(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	ErlNifBinary bin, id;
 	geef_repository *repo;
 	geef_object *obj;
+	git_object *parsed;
 	ERL_NIF_TERM type, term_obj;
 
 	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
@@ -71,16 +74,21 @@ geef_revparse_ext(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (geef_terminate_binary(&bin) < 0)
 		return geef_oom(env);
 
-	obj = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-	if (!obj)
-		return geef_oom(env);
-
-	error = git_revparse_ext(&obj->obj, &ref, repo->repo, (char *) bin.data);
+	error = git_revparse_ext(&parsed, &ref, repo->repo, (char *) bin.data);
 	if (error < 0) {
 		enif_release_binary(&bin);
 		return geef_error_struct(env, error);
 	}
 
+	obj = enif_alloc_resource(geef_object_type, sizeof(geef_object));
+	if (!obj) {
+		git_reference_free(ref);
+		git_object_free(parsed);
+		return geef_oom(env);
+	}
+
+	geef_object_intern(obj, repo, parsed);
+
 	if (ref) {
 		name = git_reference_name(ref);
 		len = strlen(name);
@@ -102,8 +110,5 @@ geef_revparse_ext(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	term_obj = enif_make_resource(env, obj);
 	enif_release_resource(obj);
 
-	obj->repo = repo;
-	enif_keep_resource(repo);
-
 	return enif_make_tuple5(env, atoms.ok, term_obj, type, enif_make_binary(env, &id), ref ? enif_make_binary(env, &bin) : atoms.nil);
 }
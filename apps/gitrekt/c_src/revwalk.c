@@ -1,6 +1,7 @@
 #include "geef.h"
 #include "oid.h"
 #include "revwalk.h"
+#include "stats.h"
 #include <string.h>
 #include <git2.h>
 
@@ -9,6 +10,8 @@ void geef_revwalk_free(ErlNifEnv *env, void *cd)
 	geef_revwalk *walk = (geef_revwalk *)cd;
 	enif_release_resource(walk->repo);
 	git_revwalk_free(walk->walk);
+	git_pathspec_free(walk->match);
+	geef_strarray_free(&walk->pathspec);
 }
 
 ERL_NIF_TERM
@@ -42,6 +45,9 @@ geef_revwalk_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (!walk)
 		return geef_oom(env);
 
+	walk->pathspec = (git_strarray){ NULL, 0 };
+	walk->match = NULL;
+
 	error = git_revwalk_new(&walk->walk, repo->repo);
 	if (error < 0)
 	{
@@ -104,6 +110,185 @@ geef_revwalk_next(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	return enif_make_tuple2(env, atoms.ok, enif_make_binary(env, &bin));
 }
 
+/*
+ * Returns 1 if the commit changes a path matching the walk's pathspec, comparing it to its first parent
+ * (or, for root commits, if its tree contains a matching path), 0 if it doesn't, or an error code.
+ */
+static int revwalk_match_commit(geef_revwalk *walk, const git_oid *oid)
+{
+	git_diff_options opts = GIT_DIFF_OPTIONS_INIT;
+	git_commit *commit, *parent = NULL;
+	git_tree *tree, *parent_tree = NULL;
+	git_diff *diff;
+	int error;
+
+	if (walk->match == NULL)
+		return 1;
+
+	if ((error = git_commit_lookup(&commit, walk->repo->repo, oid)) < 0)
+		return error;
+
+	if ((error = git_commit_tree(&tree, commit)) < 0)
+		goto cleanup_commit;
+
+	if (git_commit_parentcount(commit) == 0) {
+		error = git_pathspec_match_tree(NULL, tree, GIT_PATHSPEC_NO_MATCH_ERROR, walk->match);
+		if (error == GIT_ENOTFOUND)
+			error = 0;
+		else if (error == 0)
+			error = 1;
+		goto cleanup_tree;
+	}
+
+	if ((error = git_commit_parent(&parent, commit, 0)) < 0 ||
+	    (error = git_commit_tree(&parent_tree, parent)) < 0)
+		goto cleanup_parent;
+
+	opts.pathspec = walk->pathspec;
+	if ((error = git_diff_tree_to_tree(&diff, walk->repo->repo, parent_tree, tree, &opts)) < 0)
+		goto cleanup_parent;
+
+	error = git_diff_num_deltas(diff) > 0;
+	git_diff_free(diff);
+
+cleanup_parent:
+	git_tree_free(parent_tree);
+	git_commit_free(parent);
+cleanup_tree:
+	git_tree_free(tree);
+cleanup_commit:
+	git_commit_free(commit);
+	return error;
+}
+
+/* Work done between two checks of the scheduler timeslice, in microseconds */
+#define REVWALK_SLICE_USEC 200
+#define REVWALK_TIMESLICE_USEC 1000
+
+static ERL_NIF_TERM revwalk_next_chunk_resume(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+/*
+ * Walks up to `max` commits, accumulating the ones matching the pathspec in `acc` (in reverse order). Bounding
+ * the walked commits rather than the matching ones keeps a chunk from walking the whole history when few
+ * commits match, the chunk may then be empty. The walk yields the scheduler whenever its timeslice is consumed
+ * and resumes with the accumulated commits, the walk state itself being kept by the revwalk resource. The timeslice is checked before each commit rather than after it, so that
+ * the pathspec diff of a commit is never started once the previous ones have consumed the slice.
+ */
+static ERL_NIF_TERM revwalk_next_chunk(ErlNifEnv *env, geef_revwalk *walk, ERL_NIF_TERM walk_term, unsigned max, ERL_NIF_TERM acc, unsigned count)
+{
+	ERL_NIF_TERM result, argv[4];
+	ErlNifTime start, now;
+	ErlNifBinary bin;
+	git_oid oid;
+	int error, percent;
+
+	start = enif_monotonic_time(ERL_NIF_USEC);
+
+	while (count < max) {
+		now = enif_monotonic_time(ERL_NIF_USEC);
+		if (now - start >= REVWALK_SLICE_USEC) {
+			percent = (int)((now - start) * 100 / REVWALK_TIMESLICE_USEC);
+			if (enif_consume_timeslice(env, percent > 100 ? 100 : percent)) {
+				argv[0] = walk_term;
+				argv[1] = enif_make_uint(env, max);
+				argv[2] = acc;
+				argv[3] = enif_make_uint(env, count);
+				return geef_stats_schedule_nif(env, "revwalk_next_chunk", 0, revwalk_next_chunk_resume, 4, argv);
+			}
+			start = now;
+		}
+
+		error = git_revwalk_next(&oid, walk->walk);
+		if (error == GIT_ITEROVER) {
+			enif_make_reverse_list(env, acc, &result);
+			return enif_make_tuple3(env, atoms.ok, result, atoms.iterover);
+		}
+
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		error = revwalk_match_commit(walk, &oid);
+		if (error < 0)
+			return geef_error_struct(env, error);
+
+		if (error) {
+			if (!enif_alloc_binary(GIT_OID_RAWSZ, &bin))
+				return geef_oom(env);
+
+			git_oid_cpy((git_oid *)bin.data, &oid);
+			acc = enif_make_list_cell(env, enif_make_binary(env, &bin), acc);
+		}
+
+		count++;
+	}
+
+	enif_make_reverse_list(env, acc, &result);
+	return enif_make_tuple2(env, atoms.ok, result);
+}
+
+static ERL_NIF_TERM
+revwalk_next_chunk_continue(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_revwalk *walk;
+	unsigned max, count;
+
+	if (!enif_get_resource(env, argv[0], geef_revwalk_type, (void **)&walk) ||
+	    !enif_get_uint(env, argv[1], &max) ||
+	    !enif_get_uint(env, argv[3], &count))
+		return enif_make_badarg(env);
+
+	return revwalk_next_chunk(env, walk, argv[0], max, argv[2], count);
+}
+
+static ERL_NIF_TERM
+revwalk_next_chunk_resume(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	return geef_stats_resume(revwalk_next_chunk_continue, env, argc, argv);
+}
+
+ERL_NIF_TERM
+geef_revwalk_next_chunk(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_revwalk *walk;
+	unsigned max;
+
+	if (!enif_get_resource(env, argv[0], geef_revwalk_type, (void **)&walk))
+		return enif_make_badarg(env);
+
+	if (!enif_get_uint(env, argv[1], &max) || max == 0)
+		return enif_make_badarg(env);
+
+	return revwalk_next_chunk(env, walk, argv[0], max, enif_make_list(env, 0), 0);
+}
+
+ERL_NIF_TERM
+geef_revwalk_pathspec(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	geef_revwalk *walk;
+	git_strarray pathspec;
+	git_pathspec *match = NULL;
+
+	if (!enif_get_resource(env, argv[0], geef_revwalk_type, (void **)&walk))
+		return enif_make_badarg(env);
+
+	if (!enif_is_list(env, argv[1]))
+		return enif_make_badarg(env);
+
+	pathspec = git_strarray_from_list(env, argv[1]);
+	if (pathspec.count > 0 && git_pathspec_new(&match, &pathspec) < 0) {
+		geef_strarray_free(&pathspec);
+		return enif_make_badarg(env);
+	}
+
+	git_pathspec_free(walk->match);
+	geef_strarray_free(&walk->pathspec);
+
+	walk->pathspec = pathspec;
+	walk->match = match;
+
+	return atoms.ok;
+}
+
 ERL_NIF_TERM
 geef_revwalk_sorting(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -157,6 +342,59 @@ geef_revwalk_reset(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	return atoms.ok;
 }
 
+/*
+ * The walk only yields commits, wanted annotated tags must be added separately along with the tags they point to.
+ * Returns a positive value if the given list is malformed.
+ */
+static int revwalk_pack_insert_tags(git_packbuilder *pb, git_repository *repo, ErlNifEnv *env, ERL_NIF_TERM list)
+{
+	ERL_NIF_TERM head, tail;
+	ErlNifBinary bin;
+	git_odb *odb;
+	git_oid oid;
+	git_otype type;
+	git_tag *tag;
+	size_t len;
+	int error;
+
+	if (!enif_is_list(env, list))
+		return 1;
+
+	error = git_repository_odb(&odb, repo);
+	if (error < 0)
+		return error;
+
+	tail = list;
+	while (enif_get_list_cell(env, tail, &head, &tail)) {
+		if (!enif_inspect_binary(env, head, &bin) || bin.size != GIT_OID_RAWSZ) {
+			git_odb_free(odb);
+			return 1;
+		}
+
+		git_oid_fromraw(&oid, bin.data);
+		while (git_odb_read_header(&len, &type, odb, &oid) == 0 && type == GIT_OBJ_TAG) {
+			error = git_packbuilder_insert(pb, &oid, NULL);
+			if (error < 0)
+				break;
+
+			error = git_tag_lookup(&tag, repo, &oid);
+			if (error < 0)
+				break;
+
+			git_oid_cpy(&oid, git_tag_target_id(tag));
+			git_tag_free(tag);
+		}
+
+		if (error < 0) {
+			git_odb_free(odb);
+			return error;
+		}
+	}
+
+	git_odb_free(odb);
+	return 0;
+}
+
 ERL_NIF_TERM
 geef_revwalk_pack(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
@@ -167,7 +405,7 @@ geef_revwalk_pack(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	int error;
 
 	if (!enif_get_resource(env, argv[0], geef_revwalk_type, (void **)&walk))
-		return enif_make_badarg(env);
+		return geef_badarg(env);
 
 	error = git_packbuilder_new(&pb, walk->repo->repo);
 	if (error < 0)
@@ -180,6 +418,15 @@ geef_revwalk_pack(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 		return geef_error_struct(env, error);
 	}
 
+	error = revwalk_pack_insert_tags(pb, walk->repo->repo, env, argv[1]);
+	if (error != 0)
+	{
+		git_packbuilder_free(pb);
+		if (error > 0)
+			return geef_badarg(env);
+		return geef_error_struct(env, error);
+	}
+
 	error = git_packbuilder_write_buf(&buf, pb);
 	git_packbuilder_free(pb);
 
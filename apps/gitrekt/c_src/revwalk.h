@@ -10,6 +10,8 @@ extern ErlNifResourceType *geef_revwalk_type;
 typedef struct {
 	git_revwalk *walk;
 	geef_repository *repo;
+	git_strarray pathspec;
+	git_pathspec *match;
 } geef_revwalk;
 
 void geef_revwalk_free(ErlNifEnv *env, void *cd);
@@ -17,6 +19,8 @@ void geef_revwalk_free(ErlNifEnv *env, void *cd);
 ERL_NIF_TERM geef_revwalk_repository(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_revwalk_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_revwalk_next(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_revwalk_next_chunk(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_revwalk_pathspec(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_revwalk_push(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_revwalk_sorting(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_revwalk_simplify_first_parent(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
@@ -0,0 +1,223 @@
+#include "erl_nif.h"
+#include "geef.h"
+#include "stats.h"
+#include <string.h>
+
+/*
+ * Every NIF in geef_funcs goes through geef_stats_call(). When stats are
+ * enabled, calls are timed and counted in per-thread slots so that schedulers
+ * never write to the same counters; geef_stats/1 sums the slots.
+ *
+ * NIFs yielding through geef_stats_schedule_nif() have their continuations
+ * accounted to the NIF which scheduled them: the calling NIF is passed to the
+ * continuation as an extra argument and geef_stats_resume() unwraps it. The
+ * time spent in a continuation adds up to the duration of the original call
+ * but not to its call count.
+ *
+ * Returned bytes are an estimate: only binaries nested in the first few
+ * elements of each tuple or list are counted, so that accounting a call never
+ * walks its whole result. The maximum duration is reset only by readers
+ * asking for it, see geef_stats().
+ */
+
+#define GEEF_STATS_SLOTS 64
+
+/* Nesting depth up to which binaries are searched in returned terms */
+#define GEEF_STATS_TERM_DEPTH 4
+
+/* Number of elements of each tuple or list searched for binaries */
+#define GEEF_STATS_TERM_SAMPLE 16
+
+typedef struct {
+	ErlNifUInt64 calls;
+	ErlNifUInt64 total_ns;
+	ErlNifUInt64 max_ns;
+	ErlNifUInt64 bytes;
+} stats_counters;
+
+static const ErlNifFunc *stats_funcs;
+static unsigned stats_count;
+static stats_counters *stats_table;
+static int stats_enabled;
+static unsigned stats_next_slot;
+static __thread int stats_slot = -1;
+static __thread int stats_current = -1;
+
+int geef_stats_init(const ErlNifFunc *funcs, unsigned count)
+{
+	stats_table = enif_alloc(sizeof(stats_counters) * count * GEEF_STATS_SLOTS);
+	if (stats_table == NULL)
+		return -1;
+
+	memset(stats_table, 0, sizeof(stats_counters) * count * GEEF_STATS_SLOTS);
+	stats_funcs = funcs;
+	stats_count = count;
+
+	return 0;
+}
+
+void geef_stats_enable(int enabled)
+{
+	__atomic_store_n(&stats_enabled, enabled, __ATOMIC_RELAXED);
+}
+
+int geef_stats_enabled(void)
+{
+	return __atomic_load_n(&stats_enabled, __ATOMIC_RELAXED);
+}
+
+static size_t stats_term_bytes(ErlNifEnv *env, ERL_NIF_TERM term, int depth)
+{
+	const ERL_NIF_TERM *elems;
+	ERL_NIF_TERM head, tail;
+	ErlNifBinary bin;
+	size_t bytes = 0;
+	int i, arity, n;
+
+	if (enif_is_binary(env, term) && enif_inspect_binary(env, term, &bin))
+		return bin.size;
+
+	if (depth == 0)
+		return 0;
+
+	if (enif_get_tuple(env, term, &arity, &elems)) {
+		for (i = 0; i < arity && i < GEEF_STATS_TERM_SAMPLE; i++)
+			bytes += stats_term_bytes(env, elems[i], depth - 1);
+	} else {
+		for (n = 0; n < GEEF_STATS_TERM_SAMPLE && enif_get_list_cell(env, term, &head, &tail); n++) {
+			bytes += stats_term_bytes(env, head, depth - 1);
+			term = tail;
+		}
+	}
+
+	return bytes;
+}
+
+static void stats_account(unsigned index, ErlNifEnv *env, ErlNifUInt64 calls, ErlNifUInt64 elapsed, ERL_NIF_TERM result)
+{
+	stats_counters *counters;
+	ErlNifUInt64 max;
+
+	if (stats_slot < 0)
+		stats_slot = __atomic_fetch_add(&stats_next_slot, 1, __ATOMIC_RELAXED) % GEEF_STATS_SLOTS;
+
+	/* slots are shared once there are more threads than slots, hence the atomics */
+	counters = &stats_table[stats_slot * stats_count + index];
+	__atomic_add_fetch(&counters->calls, calls, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&counters->total_ns, elapsed, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&counters->bytes, stats_term_bytes(env, result, GEEF_STATS_TERM_DEPTH), __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&counters->max_ns, __ATOMIC_RELAXED);
+	while (elapsed > max && !__atomic_compare_exchange_n(&counters->max_ns, &max, elapsed, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+ERL_NIF_TERM
+geef_stats_call(unsigned index, ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ErlNifTime start;
+	ERL_NIF_TERM result;
+
+	if (!geef_stats_enabled()) {
+		stats_current = -1;
+		return fptr(env, argc, argv);
+	}
+
+	stats_current = (int)index;
+	start = enif_monotonic_time(ERL_NIF_NSEC);
+	result = fptr(env, argc, argv);
+	stats_account(index, env, 1, (ErlNifUInt64)(enif_monotonic_time(ERL_NIF_NSEC) - start), result);
+	stats_current = -1;
+
+	return result;
+}
+
+/*
+ * Schedules `fptr` like enif_schedule_nif(), passing the NIF currently accounted for as an extra argument. The
+ * continuation must call geef_stats_resume(), at most GEEF_STATS_SCHEDULE_ARGS arguments are supported.
+ */
+ERL_NIF_TERM
+geef_stats_schedule_nif(ErlNifEnv *env, const char *name, int flags, ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), int argc, const ERL_NIF_TERM argv[])
+{
+	ERL_NIF_TERM args[GEEF_STATS_SCHEDULE_ARGS + 1];
+
+	if (argc > GEEF_STATS_SCHEDULE_ARGS)
+		return enif_make_badarg(env);
+
+	memcpy(args, argv, sizeof(ERL_NIF_TERM) * argc);
+	args[argc] = enif_make_int(env, stats_current);
+
+	return enif_schedule_nif(env, name, flags, fptr, argc + 1, args);
+}
+
+/* Runs a continuation scheduled by geef_stats_schedule_nif(), accounting for it if stats are enabled */
+ERL_NIF_TERM
+geef_stats_resume(ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ErlNifTime start;
+	ERL_NIF_TERM result;
+	int index;
+
+	if (argc < 1 || !enif_get_int(env, argv[argc - 1], &index))
+		return enif_make_badarg(env);
+
+	if (index < 0 || (unsigned)index >= stats_count || !geef_stats_enabled()) {
+		stats_current = -1;
+		return fptr(env, argc - 1, argv);
+	}
+
+	stats_current = index;
+	start = enif_monotonic_time(ERL_NIF_NSEC);
+	result = fptr(env, argc - 1, argv);
+	stats_account((unsigned)index, env, 0, (ErlNifUInt64)(enif_monotonic_time(ERL_NIF_NSEC) - start), result);
+	stats_current = -1;
+
+	return result;
+}
+
+/*
+ * When argv[0] is true, the maximum durations are reset so that the next
+ * resetting read covers the interval since this one. Readers which do not
+ * own that interval (anything but the telemetry poller) must pass false.
+ */
+ERL_NIF_TERM
+geef_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	stats_counters sum, *counters;
+	ErlNifUInt64 max;
+	ERL_NIF_TERM list, entry;
+	unsigned i, slot;
+	int reset;
+
+	reset = !enif_compare(argv[0], atoms.true);
+	list = enif_make_list(env, 0);
+
+	for (i = stats_count; i-- > 0;) {
+		memset(&sum, 0, sizeof(sum));
+		for (slot = 0; slot < GEEF_STATS_SLOTS; slot++) {
+			counters = &stats_table[slot * stats_count + i];
+			sum.calls += __atomic_load_n(&counters->calls, __ATOMIC_RELAXED);
+			sum.total_ns += __atomic_load_n(&counters->total_ns, __ATOMIC_RELAXED);
+			sum.bytes += __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+			if (reset)
+				max = __atomic_exchange_n(&counters->max_ns, 0, __ATOMIC_RELAXED);
+			else
+				max = __atomic_load_n(&counters->max_ns, __ATOMIC_RELAXED);
+			if (max > sum.max_ns)
+				sum.max_ns = max;
+		}
+
+		if (sum.calls == 0)
+			continue;
+
+		entry = enif_make_tuple6(env,
+			enif_make_atom(env, stats_funcs[i].name),
+			enif_make_uint(env, stats_funcs[i].arity),
+			enif_make_uint64(env, sum.calls),
+			enif_make_uint64(env, sum.total_ns),
+			enif_make_uint64(env, sum.max_ns),
+			enif_make_uint64(env, sum.bytes));
+		list = enif_make_list_cell(env, entry, list);
+	}
+
+	return enif_make_tuple2(env, atoms.ok, list);
+}
@@ -0,0 +1,17 @@
+#ifndef GEEF_STATS_H
+#define GEEF_STATS_H
+
+/* Maximum number of arguments of a continuation scheduled by geef_stats_schedule_nif() */
+#define GEEF_STATS_SCHEDULE_ARGS 8
+
+int geef_stats_init(const ErlNifFunc *funcs, unsigned count);
+void geef_stats_enable(int enabled);
+int geef_stats_enabled(void);
+
+ERL_NIF_TERM geef_stats_call(unsigned index, ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_stats_schedule_nif(ErlNifEnv *env, const char *name, int flags, ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_stats_resume(ERL_NIF_TERM (*fptr)(ErlNifEnv *, int, const ERL_NIF_TERM []), ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM geef_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif
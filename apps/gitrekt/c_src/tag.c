@@ -49,6 +49,7 @@ geef_tag_peel(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
 	int error;
 	geef_object *obj, *peeled;
+	git_object *target;
 	ERL_NIF_TERM term_peeled;
 	ErlNifBinary id;
 
@@ -58,23 +59,23 @@ geef_tag_peel(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 	if (git_object_type(obj->obj) != GIT_OBJ_TAG)
 		return enif_make_badarg(env);
 
+	error = git_tag_peel(&target, (git_tag *)obj->obj);
+	if (error < 0)
+		return geef_error_struct(env, error);
+
 	peeled = enif_alloc_resource(geef_object_type, sizeof(geef_object));
-	if (!peeled)
+	if (!peeled) {
+		git_object_free(target);
 		return geef_oom(env);
+	}
 
-	error = git_tag_peel(&peeled->obj, (git_tag *)obj->obj);
-	if (error < 0)
-		return geef_error_struct(env, error);
+	geef_object_intern(peeled, obj->repo, target);
 
 	if(geef_oid_bin(&id, git_object_id(peeled->obj)) < 0) {
 		enif_release_resource(peeled);
-		git_object_free(obj->obj);
 		return geef_oom(env);
 	}
 
-	peeled->repo = obj->repo;
-	enif_keep_resource(peeled->repo);
-
 	term_peeled = enif_make_resource(env, peeled);
 	enif_release_resource(peeled);
 
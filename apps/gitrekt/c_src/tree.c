@@ -1,9 +1,11 @@
 #include <git2.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 
 #include "oid.h"
 #include "geef.h"
+#include "repository.h"
 #include "tree.h"
 
 static int geef_string_bin(ErlNifBinary *bin, const char *str)
@@ -122,3 +124,95 @@ geef_tree_count(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
 	return enif_make_tuple2(env, atoms.ok, enif_make_uint64(env, git_tree_entrycount((git_tree *) obj->obj)));
 }
+
+static void tree_updates_free(git_tree_update *updates, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		free((char *) updates[i].path);
+
+	free(updates);
+}
+
+static int tree_update_from_term(git_tree_update *update, ErlNifEnv *env, ERL_NIF_TERM term)
+{
+	const ERL_NIF_TERM *tuple;
+	int arity;
+	unsigned int mode;
+	ErlNifBinary bin;
+
+	if (!enif_get_tuple(env, term, &arity, &tuple))
+		return 0;
+
+	if (arity == 4 && !enif_compare(tuple[0], atoms.tree_upsert)) {
+		update->action = GIT_TREE_UPDATE_UPSERT;
+
+		if (!enif_inspect_binary(env, tuple[2], &bin) || bin.size != GIT_OID_RAWSZ)
+			return 0;
+
+		git_oid_fromraw(&update->id, bin.data);
+
+		if (!enif_get_uint(env, tuple[3], &mode))
+			return 0;
+
+		update->filemode = mode;
+	} else if (arity == 2 && !enif_compare(tuple[0], atoms.tree_remove)) {
+		update->action = GIT_TREE_UPDATE_REMOVE;
+	} else {
+		return 0;
+	}
+
+	if (!enif_inspect_binary(env, tuple[1], &bin))
+		return 0;
+
+	update->path = strndup((char *) bin.data, bin.size);
+
+	return update->path != NULL;
+}
+
+ERL_NIF_TERM
+geef_tree_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	int error;
+	geef_repository *repo;
+	geef_object *obj;
+	ERL_NIF_TERM head, tail;
+	unsigned int count, i;
+	git_tree_update *updates;
+	git_oid id;
+	ErlNifBinary bin;
+
+	if (!enif_get_resource(env, argv[0], geef_repository_type, (void **) &repo))
+		return enif_make_badarg(env);
+
+	if (!enif_get_resource(env, argv[1], geef_object_type, (void **) &obj))
+		return enif_make_badarg(env);
+
+	if (!enif_get_list_length(env, argv[2], &count))
+		return enif_make_badarg(env);
+
+	updates = calloc(count, sizeof(git_tree_update));
+	if (updates == NULL && count > 0)
+		return geef_oom(env);
+
+	tail = argv[2];
+	for (i = 0; i < count; i++) {
+		if (!enif_get_list_cell(env, tail, &head, &tail) ||
+		    !tree_update_from_term(&updates[i], env, head)) {
+			tree_updates_free(updates, count);
+			return enif_make_badarg(env);
+		}
+	}
+
+	error = git_tree_create_updated(&id, repo->repo, (git_tree *) obj->obj, count, updates);
+	tree_updates_free(updates, count);
+
+	if (error < 0)
+		return geef_error_struct(env, error);
+
+	if (geef_oid_bin(&bin, &id) < 0)
+		return geef_oom(env);
+
+	return enif_make_tuple2(env, atoms.ok, enif_make_binary(env, &bin));
+}
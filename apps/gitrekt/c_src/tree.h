@@ -7,5 +7,6 @@ ERL_NIF_TERM geef_tree_byid(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 ERL_NIF_TERM geef_tree_bypath(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_tree_nth(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM geef_tree_count(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_tree_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
 
 #endif
@@ -0,0 +1,334 @@
+#include "erl_nif.h"
+#include "geef.h"
+#include "worker.h"
+#include "revwalk.h"
+#include "merge.h"
+#include "alloc.h"
+#include <string.h>
+
+/*
+ * Native thread pool for heavyweight jobs.
+ *
+ * An *_async NIF copies its arguments into a job, queues it and immediately returns a reference. A worker thread
+ * then runs the synchronous NIF on the job's environment and sends {geef_async, Ref, Result} to the caller.
+ * The job's environment is process independent, synchronous NIFs run by jobs report invalid arguments with
+ * geef_badarg() rather than raising.
+ *
+ * Jobs monitor their owner, the caller unless given otherwise (e.g. the client of a GitAgent building a pack on
+ * its behalf): when it goes down, a queued job is dropped, the result of a running job discarded, and the caller
+ * receives {geef_async, Ref, {error, cancelled}} instead.
+ */
+
+#define GEEF_WORKERS_DEFAULT 4
+#define GEEF_WORKERS_MAX 64
+#define GEEF_JOB_MAX_ARGS 4
+
+typedef ERL_NIF_TERM (*geef_job_fn)(ErlNifEnv *, int, const ERL_NIF_TERM []);
+
+typedef struct geef_job {
+	ErlNifEnv *env;
+	ERL_NIF_TERM ref;
+	ERL_NIF_TERM argv[GEEF_JOB_MAX_ARGS];
+	int argc;
+	geef_job_fn fptr;
+	ErlNifPid caller;
+	ErlNifPid owner;
+	ErlNifMonitor monitor;
+	int cancelled;
+	struct geef_job *next;
+} geef_job;
+
+static ErlNifResourceType *geef_job_type;
+
+static ErlNifMutex *worker_lock;
+static ErlNifCond *worker_cond;
+static ErlNifTid worker_tids[GEEF_WORKERS_MAX];
+static unsigned worker_count;
+static int worker_stop;
+
+static geef_job *queue_head, *queue_tail;
+static unsigned queue_depth;
+static unsigned worker_running;
+static ErlNifUInt64 worker_completed;
+static ErlNifUInt64 worker_cancelled;
+
+static void geef_job_free(ErlNifEnv *env, void *obj)
+{
+	geef_job *job = (geef_job *)obj;
+
+	if (job->env)
+		enif_free_env(job->env);
+}
+
+static void geef_job_down(ErlNifEnv *env, void *obj, ErlNifPid *pid, ErlNifMonitor *mon)
+{
+	geef_job *job = (geef_job *)obj;
+
+	__atomic_store_n(&job->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+static geef_job *worker_dequeue(void)
+{
+	geef_job *job;
+
+	enif_mutex_lock(worker_lock);
+	while (queue_head == NULL && !worker_stop)
+		enif_cond_wait(worker_cond, worker_lock);
+
+	if (worker_stop) {
+		enif_mutex_unlock(worker_lock);
+		return NULL;
+	}
+
+	job = queue_head;
+	queue_head = job->next;
+	if (queue_head == NULL)
+		queue_tail = NULL;
+
+	queue_depth--;
+	worker_running++;
+	enif_mutex_unlock(worker_lock);
+
+	return job;
+}
+
+static void worker_run(geef_job *job)
+{
+	ERL_NIF_TERM result = 0;
+	int cancelled;
+	geef_alloc_owner *prev;
+
+	cancelled = __atomic_load_n(&job->cancelled, __ATOMIC_RELAXED);
+	if (!cancelled) {
+		prev = geef_alloc_enter(job->env, job->argc, job->argv);
+		result = job->fptr(job->env, job->argc, job->argv);
+		geef_alloc_leave(prev);
+		cancelled = __atomic_load_n(&job->cancelled, __ATOMIC_RELAXED);
+	}
+
+	if (cancelled)
+		result = enif_make_tuple2(job->env, atoms.error, atoms.cancelled);
+	else
+		enif_demonitor_process(NULL, job, &job->monitor);
+
+	enif_send(NULL, &job->caller, job->env, enif_make_tuple3(job->env, atoms.geef_async, job->ref, result));
+
+	enif_mutex_lock(worker_lock);
+	worker_running--;
+	if (cancelled)
+		worker_cancelled++;
+	else
+		worker_completed++;
+	enif_mutex_unlock(worker_lock);
+
+	enif_release_resource(job);
+}
+
+static void *worker_loop(void *arg)
+{
+	geef_job *job;
+
+	while ((job = worker_dequeue()) != NULL)
+		worker_run(job);
+
+	return NULL;
+}
+
+int geef_worker_init(ErlNifEnv *env)
+{
+	ErlNifResourceTypeInit init = { geef_job_free, NULL, geef_job_down };
+
+	geef_job_type = enif_open_resource_type_x(env, "job_type", &init, ERL_NIF_RT_CREATE, NULL);
+	if (geef_job_type == NULL)
+		return -1;
+
+	worker_lock = enif_mutex_create("geef_worker_lock");
+	worker_cond = enif_cond_create("geef_worker_cond");
+	if (worker_lock == NULL || worker_cond == NULL)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Starts `size` worker threads, or the default number of workers if `size` is 0. Returns a positive value if
+ * the pool is already running with a different size.
+ */
+int geef_worker_start(unsigned size)
+{
+	unsigned i;
+	int error = 0;
+
+	enif_mutex_lock(worker_lock);
+
+	if (worker_count > 0) {
+		error = (size == 0 || size == worker_count) ? 0 : 1;
+		enif_mutex_unlock(worker_lock);
+		return error;
+	}
+
+	if (size == 0)
+		size = GEEF_WORKERS_DEFAULT;
+
+	if (size > GEEF_WORKERS_MAX) {
+		enif_mutex_unlock(worker_lock);
+		return 1;
+	}
+
+	for (i = 0; i < size; i++) {
+		if (enif_thread_create("geef_worker", &worker_tids[i], worker_loop, NULL, NULL) != 0) {
+			error = -1;
+			break;
+		}
+		worker_count++;
+	}
+
+	enif_mutex_unlock(worker_lock);
+	return error;
+}
+
+unsigned geef_worker_count(void)
+{
+	unsigned count;
+
+	enif_mutex_lock(worker_lock);
+	count = worker_count;
+	enif_mutex_unlock(worker_lock);
+	return count;
+}
+
+void geef_worker_shutdown(void)
+{
+	geef_job *job;
+	unsigned i;
+
+	enif_mutex_lock(worker_lock);
+	worker_stop = 1;
+	enif_cond_broadcast(worker_cond);
+	enif_mutex_unlock(worker_lock);
+
+	for (i = 0; i < worker_count; i++)
+		enif_thread_join(worker_tids[i], NULL);
+
+	while ((job = queue_head) != NULL) {
+		queue_head = job->next;
+		enif_release_resource(job);
+	}
+
+	enif_cond_destroy(worker_cond);
+	enif_mutex_destroy(worker_lock);
+}
+
+static ERL_NIF_TERM worker_submit(ErlNifEnv *env, geef_job_fn fptr, int argc, const ERL_NIF_TERM argv[], const ErlNifPid *owner)
+{
+	ERL_NIF_TERM ref;
+	geef_job *job;
+	int i;
+
+	if (argc > GEEF_JOB_MAX_ARGS)
+		return enif_make_badarg(env);
+
+	job = enif_alloc_resource(geef_job_type, sizeof(geef_job));
+	if (job == NULL)
+		return geef_oom(env);
+
+	memset(job, 0, sizeof(geef_job));
+	job->env = enif_alloc_env();
+	if (job->env == NULL) {
+		enif_release_resource(job);
+		return geef_oom(env);
+	}
+
+	ref = enif_make_ref(env);
+	job->ref = enif_make_copy(job->env, ref);
+	for (i = 0; i < argc; i++)
+		job->argv[i] = enif_make_copy(job->env, argv[i]);
+	job->argc = argc;
+	job->fptr = fptr;
+
+	enif_self(env, &job->caller);
+	job->owner = owner ? *owner : job->caller;
+	if (enif_monitor_process(env, job, &job->owner, &job->monitor) != 0) {
+		enif_release_resource(job);
+		return enif_make_badarg(env);
+	}
+
+	/* the queue owns the job until a worker releases it */
+	enif_mutex_lock(worker_lock);
+	if (worker_count == 0 || worker_stop) {
+		enif_mutex_unlock(worker_lock);
+		enif_demonitor_process(env, job, &job->monitor);
+		enif_release_resource(job);
+		return enif_make_tuple2(env, atoms.error, atoms.undefined);
+	}
+
+	if (queue_tail)
+		queue_tail->next = job;
+	else
+		queue_head = job;
+	queue_tail = job;
+	queue_depth++;
+
+	enif_cond_signal(worker_cond);
+	enif_mutex_unlock(worker_lock);
+
+	return enif_make_tuple2(env, atoms.ok, ref);
+}
+
+ERL_NIF_TERM
+geef_revwalk_pack_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ErlNifPid owner;
+
+	if (!enif_get_local_pid(env, argv[2], &owner))
+		return enif_make_badarg(env);
+
+	return worker_submit(env, geef_revwalk_pack, 2, argv, &owner);
+}
+
+ERL_NIF_TERM
+geef_merge_trees_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ErlNifPid owner;
+
+	if (!enif_get_local_pid(env, argv[4], &owner))
+		return enif_make_badarg(env);
+
+	return worker_submit(env, geef_merge_trees, 4, argv, &owner);
+}
+
+ERL_NIF_TERM
+geef_merge_commits_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ErlNifPid owner;
+
+	if (!enif_get_local_pid(env, argv[3], &owner))
+		return enif_make_badarg(env);
+
+	return worker_submit(env, geef_merge_commits, 3, argv, &owner);
+}
+
+ERL_NIF_TERM
+geef_async_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+	ERL_NIF_TERM stats;
+	unsigned workers, depth, running;
+	ErlNifUInt64 completed, cancelled;
+
+	enif_mutex_lock(worker_lock);
+	workers = worker_count;
+	depth = queue_depth;
+	running = worker_running;
+	completed = worker_completed;
+	cancelled = worker_cancelled;
+	enif_mutex_unlock(worker_lock);
+
+	stats = enif_make_new_map(env);
+	enif_make_map_put(env, stats, atoms.library_async_workers, enif_make_uint(env, workers), &stats);
+	enif_make_map_put(env, stats, enif_make_atom(env, "queued"), enif_make_uint(env, depth), &stats);
+	enif_make_map_put(env, stats, enif_make_atom(env, "running"), enif_make_uint(env, running), &stats);
+	enif_make_map_put(env, stats, enif_make_atom(env, "completed"), enif_make_uint64(env, completed), &stats);
+	enif_make_map_put(env, stats, enif_make_atom(env, "cancelled"), enif_make_uint64(env, cancelled), &stats);
+
+	return enif_make_tuple2(env, atoms.ok, stats);
+}
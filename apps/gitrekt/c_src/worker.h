@@ -0,0 +1,16 @@
+#ifndef GEEF_WORKER_H
+#define GEEF_WORKER_H
+
+#include "erl_nif.h"
+
+int geef_worker_init(ErlNifEnv *env);
+int geef_worker_start(unsigned size);
+unsigned geef_worker_count(void);
+void geef_worker_shutdown(void);
+
+ERL_NIF_TERM geef_revwalk_pack_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_merge_trees_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_merge_commits_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM geef_async_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif
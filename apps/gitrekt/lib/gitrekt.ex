@@ -143,6 +143,18 @@ defmodule GitRekt do
     end
   end
 
+  defmodule GitDiffIterator do
+    @moduledoc """
+    Represents an iterator over the deltas of a Git diff.
+    """
+    defstruct [:__ref__]
+    @type t :: %__MODULE__{__ref__: Git.diff_iter}
+
+    defimpl Inspect do
+      def inspect(iter, _opts), do: "<GitDiffIterator:#{inspect iter.__ref__}>"
+    end
+  end
+
   defmodule GitOdb do
     @moduledoc """
     Represents a Git ODB.
@@ -24,6 +24,11 @@ defmodule GitRekt.Cache do
   """
   @callback put_cache(cache, cache_key, cache_entry) :: :ok
 
+  @doc """
+  Deletes the entry stored under `cache_key`.
+  """
+  @callback delete_cache(cache, cache_key) :: :ok
+
   @doc """
   Returns the cache key for the given `op` or `nil` if the operation should not be cached.
   """
@@ -0,0 +1,269 @@
+defmodule GitRekt.Cache.Disk do
+  @moduledoc """
+  Persistent implementation of the `GitRekt.Cache` behaviour.
+
+  Git objects are immutable, results computed from them and keyed by OID remain valid forever. This module keeps
+  such results in an append-only log on disk, with an in-memory index pointing at each entry, so that they survive
+  agent restarts and deploys:
+
+  * entries are served from `GitRekt.Cache.LRU` first, then read back from the log and promoted to memory.
+  * an entry is written to the log only when its key has one of the shapes below and its value is plain data,
+    results holding NIF resources (commits, trees, blobs, etc.) are kept in memory only:
+    * `{:merge_trees, ancestor_oid | nil, our_oid, their_oid}` and `{:merge_commits, our_oid, their_oid}`.
+    * `{:diff, old_tree_oid | nil, new_tree_oid, opts}` (see `GitRekt.DiffCache`).
+    * `{tag, oid}` and `{tag, oid, arg}` where `tag` is an atom, used to name transactions computed from a single
+      commit or tree (see `GitRekt.GitAgent.transaction/4`).
+  * on start, the index is rebuilt by scanning the log and verifying the checksum of each record; the log is
+    truncated at the first torn or corrupted record.
+  * when more than half of the log is made of deleted or overwritten records, or when it grows beyond
+    `:max_bytes`, the log is compacted, least recently used entries being dropped first.
+
+  To use it, configure `GitRekt.GitAgent` accordingly:
+
+  ```elixir
+  config :gitrekt, GitRekt.GitAgent, cache_adapter: GitRekt.Cache.Disk
+  ```
+
+  When the cache is not started, it behaves like `GitRekt.Cache.LRU`.
+
+  ## Telemetry
+
+  Following events are emitted:
+
+  * `[:gitrekt, :disk_cache, :hit]` -- when an entry is read back from the log.
+  * `[:gitrekt, :disk_cache, :miss]` -- when an entry is not found in the log.
+  * `[:gitrekt, :disk_cache, :load]` -- when the index has been rebuilt, with `count`, `bytes` and `duration` measurements.
+  * `[:gitrekt, :disk_cache, :compact]` -- when the log has been compacted, with `count`, `bytes` and `duration` measurements.
+  """
+  use GenServer
+
+  alias GitRekt.Cache.LRU
+
+  @behaviour GitRekt.Cache
+
+  @default_max_bytes 1_073_741_824
+  @compact_min_bytes 16_777_216
+
+  @log_name "cache.log"
+
+  @log_table Module.concat(__MODULE__, Log)
+
+  @doc """
+  Starts the cache as part of a supervision tree.
+
+  Following options are supported:
+
+  * `:path` -- the directory where the log is stored.
+  * `:max_bytes` -- the maximum size of the log, defaults to 1 GB.
+  """
+  @spec start_link(keyword) :: GenServer.on_start
+  def start_link(opts) do
+    {path, opts} = Keyword.pop!(opts, :path)
+    {max_bytes, opts} = Keyword.pop(opts, :max_bytes, @default_max_bytes)
+    GenServer.start_link(__MODULE__, {path, max_bytes}, Keyword.put(opts, :name, __MODULE__))
+  end
+
+  @impl GitRekt.Cache
+  def init_cache(path, opts), do: LRU.init_cache(path, opts)
+
+  @impl GitRekt.Cache
+  def fetch_cache(path, key) when not is_nil(key) do
+    if entry = LRU.fetch_cache(path, key) do
+      entry
+    else
+      if persistent_key?(key), do: fetch_log(path, key)
+    end
+  end
+
+  @impl GitRekt.Cache
+  def put_cache(path, key, entry) when not is_nil(key) do
+    :ok = LRU.put_cache(path, key, entry)
+    if Process.whereis(__MODULE__) && persistent_key?(key) && persistent_entry?(entry) && lookup({path, key}) == [],
+      do: GenServer.cast(__MODULE__, {:put, {path, key}, :erlang.term_to_binary({path, key}), :erlang.term_to_binary(entry)}),
+    else: :ok
+  end
+
+  @impl GitRekt.Cache
+  def delete_cache(path, key) when not is_nil(key) do
+    :ok = LRU.delete_cache(path, key)
+    if Process.whereis(__MODULE__) && lookup({path, key}) != [],
+      do: GenServer.cast(__MODULE__, {:delete, {path, key}, :erlang.term_to_binary({path, key})}),
+    else: :ok
+  end
+
+  @impl GitRekt.Cache
+  defdelegate make_cache_key(op), to: LRU
+
+  #
+  # Callbacks
+  #
+
+  @impl GenServer
+  def init({path, max_bytes}) do
+    :ets.new(__MODULE__, [:set, :public, :named_table, read_concurrency: true])
+    :ets.new(@log_table, [:set, :protected, :named_table, read_concurrency: true])
+    log_path = Path.join(path, @log_name)
+    with :ok <- File.mkdir_p(path),
+         {:ok, bytes} <- load_log(log_path),
+         {:ok, log} <- File.open(log_path, [:read, :append, :binary]) do
+      :ets.insert(@log_table, {:log, log})
+      {:ok, %{path: path, log: log, max_bytes: max_bytes, bytes: bytes, live_bytes: live_bytes()}}
+    else
+      {:error, reason} ->
+        {:stop, reason}
+    end
+  end
+
+  @impl GenServer
+  def handle_cast({:put, key, key_data, data}, state) do
+    if lookup(key) == [] do
+      record = encode_record(key_data, data)
+      case IO.binwrite(state.log, record) do
+        :ok ->
+          :ets.insert(__MODULE__, {key, state.bytes, byte_size(record), System.monotonic_time()})
+          {:noreply, maybe_compact(%{state | bytes: state.bytes + byte_size(record), live_bytes: state.live_bytes + byte_size(record)})}
+        {:error, _reason} ->
+          {:noreply, state}
+      end
+    else
+      {:noreply, state}
+    end
+  end
+
+  def handle_cast({:delete, key, key_data}, state) do
+    case :ets.take(__MODULE__, key) do
+      [{^key, _offset, size, _atime}] ->
+        record = encode_record(key_data, "")
+        IO.binwrite(state.log, record)
+        {:noreply, maybe_compact(%{state | bytes: state.bytes + byte_size(record), live_bytes: state.live_bytes - size})}
+      [] ->
+        {:noreply, state}
+    end
+  end
+
+  #
+  # Helpers
+  #
+
+  defp lookup(key) do
+    if :ets.whereis(__MODULE__) != :undefined,
+      do: :ets.lookup(__MODULE__, key),
+    else: []
+  end
+
+  defp fetch_log(path, key) do
+    with [{_key, offset, size, _atime}] <- lookup({path, key}),
+         [{:log, log}] <- :ets.lookup(@log_table, :log),
+         {:ok, record} <- :file.pread(log, offset, size),
+         {:ok, {^path, ^key}, entry} <- decode_record(record) do
+      :ets.update_element(__MODULE__, {path, key}, {4, System.monotonic_time()})
+      :telemetry.execute([:gitrekt, :disk_cache, :hit], %{count: 1}, %{path: path})
+      :ok = LRU.put_cache(path, key, entry)
+      entry
+    else
+      _ ->
+        :telemetry.execute([:gitrekt, :disk_cache, :miss], %{count: 1}, %{path: path})
+        nil
+    end
+  end
+
+  defp persistent_key?({:merge_trees, ancestor, ours, theirs}), do: (is_nil(ancestor) or oid?(ancestor)) and oid?(ours) and oid?(theirs)
+  defp persistent_key?({:merge_commits, ours, theirs}), do: oid?(ours) and oid?(theirs)
+  defp persistent_key?({:diff, old_tree, new_tree, _opts}), do: (is_nil(old_tree) or oid?(old_tree)) and oid?(new_tree)
+  defp persistent_key?({tag, oid}) when is_atom(tag), do: oid?(oid)
+  defp persistent_key?({tag, oid, _arg}) when is_atom(tag), do: oid?(oid)
+  defp persistent_key?(_key), do: false
+
+  defp oid?(oid), do: is_binary(oid) and byte_size(oid) == 20
+
+  defp persistent_entry?(entry) when is_reference(entry) or is_pid(entry) or is_port(entry) or is_function(entry), do: false
+  defp persistent_entry?(entry) when is_tuple(entry), do: persistent_entry?(Tuple.to_list(entry))
+  defp persistent_entry?(entry) when is_map(entry), do: Enum.all?(entry, fn {key, val} -> persistent_entry?(key) and persistent_entry?(val) end)
+  defp persistent_entry?([head|tail]), do: persistent_entry?(head) and persistent_entry?(tail)
+  defp persistent_entry?(_entry), do: true
+
+  defp encode_record(key_data, data) do
+    [<<byte_size(key_data)::32, byte_size(data)::32, :erlang.crc32([key_data, data])::32>>, key_data, data]
+    |> IO.iodata_to_binary()
+  end
+
+  defp decode_record(<<key_size::32, data_size::32, crc::32, key_data::bytes-size(key_size), data::bytes-size(data_size)>>) when data_size > 0 do
+    if :erlang.crc32([key_data, data]) == crc,
+      do: {:ok, :erlang.binary_to_term(key_data), :erlang.binary_to_term(data)},
+    else: {:error, :checksum}
+  end
+
+  defp decode_record(_record), do: {:error, :invalid}
+
+  defp load_log(log_path) do
+    event_time = :os.system_time(:microsecond)
+    case File.open(log_path, [:read, :write, :binary, :raw, :read_ahead]) do
+      {:ok, log} ->
+        {:ok, log_size} = :file.position(log, :eof)
+        {:ok, 0} = :file.position(log, :bof)
+        offset = load_records(log, 0, log_size, System.monotonic_time())
+        {:ok, _offset} = :file.position(log, offset)
+        :ok = :file.truncate(log)
+        :ok = File.close(log)
+        :telemetry.execute([:gitrekt, :disk_cache, :load], %{count: :ets.info(__MODULE__, :size), bytes: offset, duration: :os.system_time(:microsecond) - event_time}, %{})
+        {:ok, offset}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
+  defp load_records(log, offset, log_size, atime) do
+    with {:ok, <<key_size::32, data_size::32, crc::32>>} <- :file.read(log, 12),
+         size = 12 + key_size + data_size,
+         true <- offset + size <= log_size,
+         {:ok, <<key_data::bytes-size(key_size), data::bytes-size(data_size)>>} <- :file.read(log, key_size + data_size),
+         true <- :erlang.crc32([key_data, data]) == crc do
+      key = :erlang.binary_to_term(key_data)
+      if data_size > 0,
+        do: :ets.insert(__MODULE__, {key, offset, size, atime}),
+      else: :ets.delete(__MODULE__, key)
+      load_records(log, offset + size, log_size, atime)
+    else
+      _ -> offset
+    end
+  end
+
+  defp live_bytes do
+    :ets.foldl(fn {_key, _offset, size, _atime}, acc -> acc + size end, 0, __MODULE__)
+  end
+
+  defp maybe_compact(state) when state.bytes < @compact_min_bytes, do: state
+  defp maybe_compact(state) when state.bytes - state.live_bytes <= state.live_bytes and state.bytes <= state.max_bytes, do: state
+  defp maybe_compact(state) do
+    event_time = :os.system_time(:microsecond)
+    log_path = Path.join(state.path, @log_name)
+    tmp_path = log_path <> ".tmp"
+    target = div(state.max_bytes * 9, 10)
+    entries =
+      __MODULE__
+      |> :ets.tab2list()
+      |> Enum.sort_by(&elem(&1, 3), &>=/2)
+      |> Enum.reduce_while({[], 0}, fn
+        {_key, _offset, size, _atime}, {_acc, bytes} = acc when bytes + size > target -> {:halt, acc}
+        {_key, _offset, size, _atime} = entry, {acc, bytes} -> {:cont, {[entry|acc], bytes + size}}
+      end)
+      |> elem(0)
+    {:ok, tmp} = File.open(tmp_path, [:write, :binary, :raw, :delayed_write])
+    {index, bytes} =
+      Enum.reduce(entries, {[], 0}, fn {key, offset, size, atime}, {index, bytes} ->
+        {:ok, record} = :file.pread(state.log, offset, size)
+        :ok = :file.write(tmp, record)
+        {[{key, bytes, size, atime}|index], bytes + size}
+      end)
+    :ok = :file.sync(tmp)
+    :ok = File.close(tmp)
+    :ok = File.rename(tmp_path, log_path)
+    {:ok, log} = File.open(log_path, [:read, :append, :binary])
+    :ets.insert(@log_table, {:log, log})
+    :ets.delete_all_objects(__MODULE__)
+    :ets.insert(__MODULE__, index)
+    :ok = File.close(state.log)
+    :telemetry.execute([:gitrekt, :disk_cache, :compact], %{count: length(index), bytes: state.bytes - bytes, duration: :os.system_time(:microsecond) - event_time}, %{})
+    %{state | log: log, bytes: bytes, live_bytes: bytes}
+  end
+end
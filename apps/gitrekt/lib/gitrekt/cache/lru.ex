@@ -0,0 +1,183 @@
+defmodule GitRekt.Cache.LRU do
+  @moduledoc """
+  Size-bounded implementation of the `GitRekt.Cache` behaviour.
+
+  Entries are stored in a single node-wide ETS table, keyed by repository path, so that all the agents of a
+  repository share the same cache. Each entry is accounted for by its external term size:
+
+  * each repository is bounded by the `:max_repo_bytes` option.
+  * all repositories together are bounded by the `:max_bytes` option.
+
+  When a budget is exceeded, least recently used entries are evicted first, until usage drops to 90% of the budget.
+  Eviction runs asynchronously; while it is pending for a repository, further inserts do not request it again.
+
+  To use it, configure `GitRekt.GitAgent` accordingly:
+
+  ```elixir
+  config :gitrekt, GitRekt.GitAgent, cache_adapter: GitRekt.Cache.LRU
+  ```
+
+  When the cache is not started, `fetch_cache/2` always misses and `put_cache/3` is a no-op.
+
+  ## Telemetry
+
+  Following events are emitted:
+
+  * `[:gitrekt, :cache, :hit]` -- when an entry is served from the cache.
+  * `[:gitrekt, :cache, :miss]` -- when an entry is not found in the cache.
+  * `[:gitrekt, :cache, :evict]` -- when entries are evicted, with `count` and `bytes` measurements.
+  """
+  use GenServer
+
+  alias GitRekt.GitAgent
+
+  @behaviour GitRekt.Cache
+
+  @default_max_bytes 268_435_456
+  @default_max_repo_bytes 33_554_432
+
+  @bytes_table Module.concat(__MODULE__, Bytes)
+
+  @doc """
+  Starts the cache as part of a supervision tree.
+
+  Following options are supported:
+
+  * `:max_bytes` -- the maximum size of the cache for all repositories, defaults to 256 MB.
+  * `:max_repo_bytes` -- the maximum size of the cache for a single repository, defaults to 32 MB.
+  """
+  @spec start_link(keyword) :: GenServer.on_start
+  def start_link(opts \\ []) do
+    {max_bytes, opts} = Keyword.pop(opts, :max_bytes, @default_max_bytes)
+    {max_repo_bytes, opts} = Keyword.pop(opts, :max_repo_bytes, @default_max_repo_bytes)
+    GenServer.start_link(__MODULE__, {max_bytes, max_repo_bytes}, Keyword.put(opts, :name, __MODULE__))
+  end
+
+  @doc """
+  Returns the number of bytes used by the cache of the given `path`, or by all repositories.
+  """
+  @spec bytes(Path.t | nil) :: non_neg_integer
+  def bytes(path \\ nil)
+  def bytes(nil), do: bytes_lookup(:total)
+  def bytes(path), do: bytes_lookup({:repo, path})
+
+  @impl GitRekt.Cache
+  def init_cache(path, _opts), do: path
+
+  @impl GitRekt.Cache
+  def fetch_cache(path, key) when not is_nil(key) do
+    case lookup({path, key}) do
+      [{_key, entry, _size, _atime}] ->
+        :ets.update_element(__MODULE__, {path, key}, {4, System.monotonic_time()})
+        :telemetry.execute([:gitrekt, :cache, :hit], %{count: 1}, %{path: path})
+        entry
+      [] ->
+        :telemetry.execute([:gitrekt, :cache, :miss], %{count: 1}, %{path: path})
+        nil
+    end
+  end
+
+  @impl GitRekt.Cache
+  def put_cache(path, key, entry) when not is_nil(key) do
+    if :ets.whereis(__MODULE__) != :undefined do
+      size = :erlang.external_size(entry)
+      if :ets.insert_new(__MODULE__, {{path, key}, entry, size, System.monotonic_time()}) do
+        repo_bytes = :ets.update_counter(@bytes_table, {:repo, path}, size, {{:repo, path}, 0})
+        total_bytes = :ets.update_counter(@bytes_table, :total, size, {:total, 0})
+        if (repo_bytes > :persistent_term.get({__MODULE__, :max_repo_bytes}) or total_bytes > :persistent_term.get({__MODULE__, :max_bytes})) and :ets.insert_new(@bytes_table, {{:evict, path}, true}),
+          do: GenServer.cast(__MODULE__, {:evict, path}),
+        else: :ok
+      end
+    end
+    :ok
+  end
+
+  @impl GitRekt.Cache
+  def delete_cache(path, key) when not is_nil(key) do
+    if :ets.whereis(__MODULE__) != :undefined do
+      Enum.each(:ets.take(__MODULE__, {path, key}), &account_delete/1)
+      bytes_cleanup(path)
+    end
+    :ok
+  end
+
+  @impl GitRekt.Cache
+  defdelegate make_cache_key(op), to: GitAgent
+
+  #
+  # Callbacks
+  #
+
+  @impl GenServer
+  def init({max_bytes, max_repo_bytes}) do
+    :ets.new(__MODULE__, [:set, :public, :named_table, read_concurrency: true, write_concurrency: true])
+    :ets.new(@bytes_table, [:set, :public, :named_table, write_concurrency: true])
+    :persistent_term.put({__MODULE__, :max_bytes}, max_bytes)
+    :persistent_term.put({__MODULE__, :max_repo_bytes}, max_repo_bytes)
+    {:ok, %{max_bytes: max_bytes, max_repo_bytes: max_repo_bytes}}
+  end
+
+  @impl GenServer
+  def handle_cast({:evict, path}, state) do
+    :ets.delete(@bytes_table, {:evict, path})
+    if bytes(path) > state.max_repo_bytes,
+      do: evict(path, select_entries(path), bytes(path), state.max_repo_bytes),
+    else: :ok
+    if bytes() > state.max_bytes,
+      do: evict(nil, select_entries(nil), bytes(), state.max_bytes),
+    else: :ok
+    {:noreply, state}
+  end
+
+  #
+  # Helpers
+  #
+
+  defp lookup(key) do
+    if :ets.whereis(__MODULE__) != :undefined,
+      do: :ets.lookup(__MODULE__, key),
+    else: []
+  end
+
+  defp bytes_lookup(key) do
+    case :ets.whereis(@bytes_table) != :undefined && :ets.lookup(@bytes_table, key) do
+      [{^key, bytes}] -> bytes
+      _ -> 0
+    end
+  end
+
+  defp account_delete({{path, _key}, _entry, size, _atime}) do
+    :ets.update_counter(@bytes_table, {:repo, path}, -size)
+    :ets.update_counter(@bytes_table, :total, -size)
+  end
+
+  defp bytes_cleanup(path) do
+    # only removes the row if no entry has been inserted for the repository meanwhile
+    :ets.select_delete(@bytes_table, [{{{:repo, path}, 0}, [], [true]}])
+  end
+
+  # returns {key, size, atime} tuples without copying the cached values
+  defp select_entries(nil), do: :ets.select(__MODULE__, [{{:"$1", :_, :"$2", :"$3"}, [], [{{:"$1", :"$2", :"$3"}}]}])
+  defp select_entries(path), do: :ets.select(__MODULE__, [{{:"$1", :_, :"$2", :"$3"}, [{:==, {:element, 1, :"$1"}, {:const, path}}], [{{:"$1", :"$2", :"$3"}}]}])
+
+  defp evict(path, entries, bytes, max_bytes) do
+    target = div(max_bytes * 9, 10)
+    {count, evicted} =
+      entries
+      |> Enum.sort_by(&elem(&1, 2))
+      |> Enum.reduce_while({0, 0}, fn
+        _entry, {_count, evicted} = acc when bytes - evicted <= target ->
+          {:halt, acc}
+        {key, _size, _atime}, {count, evicted} ->
+          case :ets.take(__MODULE__, key) do
+            [{{entry_path, _key}, _entry, size, _atime} = entry] ->
+              account_delete(entry)
+              bytes_cleanup(entry_path)
+              {:cont, {count + 1, evicted + size}}
+            [] ->
+              {:cont, {count, evicted}}
+          end
+      end)
+    :telemetry.execute([:gitrekt, :cache, :evict], %{count: count, bytes: evicted}, %{path: path})
+  end
+end
@@ -0,0 +1,55 @@
+defmodule GitRekt.DiffCache do
+  @moduledoc """
+  Caching of Git diffs.
+
+  Diffs between two trees never change. This module caches results computed from a diff under a key made of the
+  old tree OID, the new tree OID and the diff options. Results are stored through the cache adapter of
+  `GitRekt.GitAgent` (see `GitRekt.Cache`), as named transactions:
+
+  ```elixir
+  key = DiffCache.key(old_tree.oid, new_tree.oid, find_renames: true)
+  {:ok, deltas} = DiffCache.fetch_or_compute(agent, key, &GitAgent.diff_deltas(&1, diff))
+  ```
+
+  With `GitRekt.Cache.Disk`, cached diffs are written to its log and survive agent restarts. They are bounded,
+  evicted and compacted along with the other persistent results.
+  """
+
+  alias GitRekt.Git
+  alias GitRekt.GitAgent
+
+  @type key :: {:diff, Git.oid | nil, Git.oid, keyword}
+
+  @doc """
+  Returns a cache key for the diff between `old_tree_oid` and `new_tree_oid` with the given `opts`.
+  """
+  @spec key(Git.oid | nil, Git.oid, keyword) :: key
+  def key(old_tree_oid, new_tree_oid, opts \\ []), do: {:diff, old_tree_oid, new_tree_oid, Enum.sort(opts)}
+
+  @doc """
+  Fetches the diff stored under the given `key`, or computes and stores it with `fun`.
+
+  The given `fun` is executed as a transaction of `agent` (see `GitRekt.GitAgent.transaction/4`). Binaries of the
+  computed result are copied before being cached: diff lines are sub-binaries of the blobs they were read from and
+  would otherwise keep these blobs and their repository alive for as long as the diff is cached.
+  """
+  @spec fetch_or_compute(GitAgent.agent, key, (GitAgent.agent -> {:ok, term} | {:error, term})) :: {:ok, term} | {:error, term}
+  def fetch_or_compute(agent, key, fun) do
+    GitAgent.transaction(agent, key, fn agent ->
+      case fun.(agent) do
+        {:ok, result} -> {:ok, copy_binaries(result)}
+        {:error, reason} -> {:error, reason}
+      end
+    end)
+  end
+
+  #
+  # Helpers
+  #
+
+  defp copy_binaries(bin) when is_binary(bin), do: :binary.copy(bin)
+  defp copy_binaries(list) when is_list(list), do: Enum.map(list, &copy_binaries/1)
+  defp copy_binaries(map) when is_map(map), do: :maps.map(fn _key, val -> copy_binaries(val) end, map)
+  defp copy_binaries(tuple) when is_tuple(tuple), do: List.to_tuple(copy_binaries(Tuple.to_list(tuple)))
+  defp copy_binaries(term), do: term
+end
@@ -226,6 +226,21 @@ defmodule GitRekt.Git do
 
   Finally we have updated the *master* branch to point at our new commit.
 
+  ## Library options
+
+  *libgit2*'s global object cache and pack window limits can be tuned with the `:library_opts` setting of the
+  `:gitrekt` application. The options are applied once, when the NIF library is loaded:
+
+  ```elixir
+  config :gitrekt, :library_opts,
+    cache_max_size: 268_435_456,
+    cache_object_limits: [blob: 0, commit: 4096, tree: 4096],
+    mwindow_mapped_limit: 1_073_741_824
+  ```
+
+  See `library_opts_set/1` for the list of supported options and `library_opts_get/0` to inspect their current
+  values at runtime.
+
   ## Thread safety
 
   Accessing a `t:repo/0` or any NIF allocated pointer (`t:blob/0`, `t:commit/0`, `t:config/0`, etc.) from multiple
@@ -238,6 +253,8 @@ defmodule GitRekt.Git do
 
   alias GitRekt.GitStream
 
+  require Logger
+
   @type repo                    :: reference
 
   @type oid                     :: binary
@@ -249,8 +266,11 @@ defmodule GitRekt.Git do
   @type odb_writepack           :: reference
   @type odb_writepack_progress  :: map
 
+  @type mempack                 :: reference
+
   @type ref_iter                :: reference
   @type ref_type                :: :oid | :symbolic
+  @type ref_update              :: {binary, oid | nil, oid | nil}
 
   @type config                  :: reference
   @type blob                    :: reference
@@ -272,10 +292,13 @@ defmodule GitRekt.Git do
 
   @type tree                    :: reference
   @type tree_entry              :: {integer, :blob | :tree, oid, binary}
+  @type tree_update             :: {:upsert, Path.t, oid, integer} | {:remove, Path.t}
 
   @type diff                    :: reference
+  @type diff_iter               :: reference
   @type diff_format             :: :patch | :patch_header | :raw | :name_only | :name_status
-  @type diff_delta              :: {diff_file, diff_file, non_neg_integer, non_neg_integer}
+  @type diff_delta              :: {diff_file, diff_file, diff_status, non_neg_integer, non_neg_integer}
+  @type diff_status             :: :unmodified | :added | :deleted | :modified | :renamed | :copied | :typechange | :undefined
   @type diff_file               :: {oid, binary, integer, non_neg_integer}
   @type diff_hunk               :: {binary, integer, integer, integer, integer}
   @type diff_line               :: {char, integer, integer, integer, integer, binary}
@@ -303,14 +326,19 @@ defmodule GitRekt.Git do
 
   @type pack                    :: reference
 
+  @type library_opts            :: %{optional(atom) => non_neg_integer | boolean | %{optional(obj_type) => non_neg_integer}}
+
   @type worktree                :: reference
 
   @on_load :load_nif
 
+  @revwalk_chunk_size 128
+
   @doc false
   def load_nif do
-    case :erlang.load_nif(nif_path(), 0) do
-      :ok -> :ok
+    opts = library_opts(Application.get_env(:gitrekt, :library_opts, []))
+    case :erlang.load_nif(nif_path(), opts) do
+      :ok -> library_opts_check(opts)
       {:error, {:load_failed, error}} -> raise RuntimeError, message: error
     end
   end
@@ -323,6 +351,22 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Returns a repository handle for the `path`, sharing its object database with the other handles opened with this
+  function on the same repository.
+
+  Each handle is still opened like with `repository_open/1` and keeps its own references, config, index and object
+  cache. Only the object database is shared: objects are read through a single object database per repository,
+  with one set of pack file maps and file descriptors, instead of one per handle.
+
+  Sharing an object database across threads requires *libgit2* 1.2 or later. With older versions, this function
+  behaves like `repository_open/1`.
+  """
+  @spec repository_open_shared(Path.t) :: {:ok, repo} | {:error, term}
+  def repository_open_shared(_path) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns `true` if `repo` is bare; elsewise returns `false`.
   """
@@ -427,6 +471,41 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Locks all the references in `updates` and applies them in a single transaction.
+
+  The current value of each reference is checked against the expected old OID before anything is written.
+
+  With the filesystem backend, each reference is still committed by renaming its own lock file, one after the
+  other. Concurrent writers never see a partial update, since every lock is held until the end, but a crash
+  in the middle of the commit phase can leave only some of the references updated.
+  """
+  @spec reference_transaction(repo, [ref_update]) :: :ok | {:error, term}
+  def reference_transaction(_repo, _updates) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Packs all the loose references of the given `repo` into the `packed-refs` file.
+  """
+  @spec refdb_compress(repo) :: :ok | {:error, term}
+  def refdb_compress(_repo) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Serves the references of the given `repo` from memory.
+
+  References of the `refs/` namespace are loaded from disk on first access and written through to disk on
+  update, `HEAD` and other top-level references are always read from disk. The in-memory table is shared by
+  all the repositories opened on the same path. Changes made to the references by other processes (such as the
+  `git` CLI) are detected within a second, the table being reloaded from disk.
+  """
+  @spec refdb_cache_enable(repo) :: :ok | {:error, term}
+  def refdb_cache_enable(_repo) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Looks for a reference by `name` and returns its id.
   """
@@ -478,6 +557,17 @@ defmodule GitRekt.Git do
     end
   end
 
+  @doc """
+  Returns all the references that match the specific `glob` pattern in a single call.
+
+  Each reference is returned along with its peeled target and the type of that target when it points to an
+  annotated tag.
+  """
+  @spec reference_list_full(repo, binary | :undefined) :: {:ok, [{binary, binary, ref_type, binary, oid | nil, obj_type | nil}]} | {:error, term}
+  def reference_list_full(_repo, _glob \\ :undefined) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Resolves a symbolic reference to a direct reference.
   """
@@ -534,6 +624,96 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Returns the number of unique commits between each of the `locals` commit objects and `upstream`.
+
+  The commit graph is walked once per batch of 63 `locals`, common history is visited only once. A walk reads at
+  most 262144 commits, past which the counts of the `locals` it paints are lower bounds.
+  """
+  @spec graph_ahead_behind_many(repo, oid, [oid]) :: {:ok, [{non_neg_integer, non_neg_integer}]} | {:error, term}
+  def graph_ahead_behind_many(_repo, _upstream, _locals) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns a list of booleans telling whether `commit` is a descendant of each of the given `ancestors`.
+
+  All the candidates are checked in a single walk over the commit graph. A commit is considered a descendant of itself.
+  The walk is ordered by commit time, commits dated before their parents are walked again once reached from them.
+  """
+  @spec graph_descendant_of(repo, oid, [oid]) :: {:ok, [boolean]} | {:error, term}
+  def graph_descendant_of(_repo, _commit, _ancestors) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the best common ancestor of the commits `one` and `two`.
+  """
+  @spec merge_base(repo, oid, oid) :: {:ok, oid} | {:error, term}
+  def merge_base(_repo, _one, _two) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the best common ancestor of the given `oids`, suitable for a merge.
+  """
+  @spec merge_base_many(repo, [oid]) :: {:ok, oid} | {:error, term}
+  def merge_base_many(_repo, _oids) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the common ancestor of all the given `oids`, suitable for an octopus merge.
+  """
+  @spec merge_base_octopus(repo, [oid]) :: {:ok, oid} | {:error, term}
+  def merge_base_octopus(_repo, _oids) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Merges `our_tree` and `their_tree` given their common `ancestor_tree` in memory.
+
+  Returns the OID of the resulting tree, or `nil` and the list of conflicting paths if the trees do not
+  merge cleanly.
+  """
+  @spec merge_trees(repo, oid | nil, oid, oid) :: {:ok, oid | nil, [Path.t]} | {:error, term}
+  def merge_trees(_repo, _ancestor_tree, _our_tree, _their_tree) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Same as `merge_trees/4` but runs on the async worker pool (see `async_await/2`).
+
+  The job is cancelled if the `owner` process exits before it completes. The `repo` may not be used until the
+  result has been received, the merge running on another thread.
+  """
+  @spec merge_trees_async(repo, oid | nil, oid, oid, pid) :: {:ok, reference} | {:error, term}
+  def merge_trees_async(_repo, _ancestor_tree, _our_tree, _their_tree, _owner \\ self()) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Merges `our_commit` and `their_commit` in memory.
+
+  Returns the OID of the resulting tree, or `nil` and the list of conflicting paths if the commits do not
+  merge cleanly.
+  """
+  @spec merge_commits(repo, oid, oid) :: {:ok, oid | nil, [Path.t]} | {:error, term}
+  def merge_commits(_repo, _our_commit, _their_commit) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Same as `merge_commits/3` but runs on the async worker pool (see `async_await/2`).
+
+  The job is cancelled if the `owner` process exits before it completes. The `repo` may not be used until the
+  result has been received, the merge running on another thread.
+  """
+  @spec merge_commits_async(repo, oid, oid, pid) :: {:ok, reference} | {:error, term}
+  def merge_commits_async(_repo, _our_commit, _their_commit, _owner \\ self()) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns the OID of an object `type` and raw `data`.
 
@@ -600,6 +780,33 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Returns an in-memory repository staging new objects into a `mempack`.
+
+  Objects written to the returned repository are kept in memory. Existing objects of `repo` are available
+  for reading.
+  """
+  @spec mempack_new(repo) :: {:ok, repo, mempack} | {:error, term}
+  def mempack_new(_repo) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Writes the objects staged in `mempack` into `repo` as a single PACK and returns the number of written objects.
+  """
+  @spec mempack_flush(mempack, repo) :: {:ok, non_neg_integer} | {:error, term}
+  def mempack_flush(_mempack, _repo) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Discards the objects staged in `mempack`.
+  """
+  @spec mempack_reset(mempack) :: :ok
+  def mempack_reset(_mempack) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns the SHA `hash` for the given `oid`.
   """
@@ -785,6 +992,16 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Creates a new tree by applying the given `updates` to `tree`.
+
+  Only the trees along the updated paths are rewritten, the rest of `tree` is reused as-is.
+  """
+  @spec tree_update(repo, tree, [tree_update]) :: {:ok, oid} | {:error, term}
+  def tree_update(_repo, _tree, _updates) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns all entries in the given `tree`.
   """
@@ -857,6 +1074,120 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Sets global *libgit2* library options.
+
+  Following options are supported:
+
+  * `:cache_max_size` -- the maximum number of bytes held by the object cache, shared by all repositories.
+  * `:cache_object_limits` -- a map of object types to the maximum size of objects of that type to be cached.
+  * `:enable_caching` -- enables or disables the object cache.
+  * `:mwindow_size` -- the size of the windows mapped from pack files.
+  * `:mwindow_mapped_limit` -- the maximum number of bytes mapped from pack files at once.
+  * `:mwindow_file_limit` -- the maximum number of pack files kept open at once (requires *libgit2* 1.1).
+  * `:strict_hash_verification` -- verifies the hash of objects read from the object database.
+  * `:memory_soft_limit` -- the number of bytes allocated by *libgit2* above which pack building and indexing
+  allocations fail and the operation requesting them returns `:enomem`, `0` disables the limit (see
+  `library_memory_stats/0`). Other allocations are never refused.
+  * `:nif_stats` -- enables or disables the collection of NIF call statistics (see `geef_stats/1`).
+  * `:async_workers` -- the number of native threads running async jobs, defaults to 4. It can only be set
+  when the NIF library is loaded (see `async_stats/0`).
+
+  Unknown options and invalid values are rejected with an `ArgumentError`. When the options are applied on load
+  (see the *Library options* section above), they are skipped with a warning instead, so that an option which is
+  not supported by the linked *libgit2* version does not prevent the library from loading.
+  """
+  @spec library_opts_set(library_opts) :: :ok | {:error, term}
+  def library_opts_set(_opts) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the current global *libgit2* library options.
+
+  The returned map contains every option supported by the linked *libgit2* version, as well as the number of
+  bytes currently held by the object cache as `:cached_memory`.
+  """
+  @spec library_opts_get() :: {:ok, map} | {:error, term}
+  def library_opts_get() do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the memory currently allocated by *libgit2*.
+
+  *libgit2* allocates through `enif_alloc/1`, so its memory is accounted for in `:erlang.memory(:system)`. The
+  returned map also contains the highest `:total` reached so far, the number of allocations which failed because
+  of the `:memory_soft_limit` and the number of bytes allocated per category (`:pack`, `:odb`, `:cache`, `:refs`,
+  `:diff` and `:other`).
+
+  `GitRekt.GitAgent` emits these stats as a `[:gitrekt, :library, :memory]` telemetry event each time it builds a pack.
+  """
+  @spec library_memory_stats() :: {:ok, map}
+  def library_memory_stats() do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the number of bytes currently allocated by *libgit2* on behalf of `repo`.
+
+  Memory is attributed to the repository passed as first argument of the NIF (or owning the revision walk)
+  allocating it, until it is freed. Memory allocated while opening a repository or through other resources, such
+  as diffs or objects, is not attributed (see `library_memory_stats/0`).
+  """
+  @spec repository_memory(repo) :: {:ok, non_neg_integer}
+  def repository_memory(_repo) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns call statistics for the NIFs of this module.
+
+  For each NIF called since the `:nif_stats` library option has been enabled, returns its name and arity, the
+  number of calls, the total time spent in these calls, the maximum time spent in a single call (in nanoseconds) and
+  an estimate of the number of bytes of the binaries it returned, including binaries nested in the first elements of
+  returned lists and tuples.
+
+  The maximum time covers the interval since the previous call with `reset_max` set to `true`. Only a single reader,
+  such as `GitGud.Telemetry.GitNIFPoller`, should reset it; other readers leave it untouched.
+
+  The time spent by NIFs yielding the scheduler, such as `revwalk_next_chunk/2`, includes their continuations.
+  """
+  @spec geef_stats(boolean) :: {:ok, [{atom, non_neg_integer, non_neg_integer, non_neg_integer, non_neg_integer, non_neg_integer}]}
+  def geef_stats(_reset_max \\ false) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the state of the async worker pool.
+
+  The returned map contains the number of `:async_workers`, the number of `:queued` and `:running` jobs, and the
+  number of jobs `:completed` or `:cancelled` because their caller exited.
+  """
+  @spec async_stats() :: {:ok, map}
+  def async_stats() do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Waits for the result of the async job identified by `ref`.
+
+  Functions suffixed with `_async` run on a pool of native threads. They return a reference immediately and
+  send `{:geef_async, ref, result}` to the calling process once done. Jobs are cancelled if their owner, the
+  caller by default, exits before they complete; the result is then `{:error, :cancelled}`.
+
+  The resources passed to an async job are used from another thread while it runs, they must not be used by any
+  process until the result has been received.
+  """
+  @spec async_await(reference, timeout) :: term
+  def async_await(ref, timeout \\ :infinity) do
+    receive do
+      {:geef_async, ^ref, result} -> result
+    after
+      timeout -> {:error, :timeout}
+    end
+  end
+
   @doc """
   Creates a new revision walk object for the given `repo`.
   """
@@ -881,6 +1212,28 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Walks up to `max` next commits from the given revision `walk`.
+
+  Only the commits matching the pathspec of the walk (see `revwalk_pathspec/2`) are returned, so that fewer
+  commits, possibly none, can be returned before the walk is exhausted. The walk runs on a normal scheduler and yields whenever it consumed its timeslice, so that long walks do not
+  block other processes. `:iterover` is returned along with the last commits once the walk is exhausted.
+  """
+  @spec revwalk_next_chunk(revwalk, pos_integer) :: {:ok, [oid]} | {:ok, [oid], :iterover} | {:error, term}
+  def revwalk_next_chunk(_walk, _max) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Restricts the revision `walk` to commits changing paths matching the given `pathspec`.
+
+  Commits are compared with their first parent. Passing an empty list removes the restriction.
+  """
+  @spec revwalk_pathspec(revwalk, [Path.t]) :: :ok | {:error, term}
+  def revwalk_pathspec(_walk, _pathspec) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Changes the sorting mode when iterating through the repository's contents.
   """
@@ -907,10 +1260,15 @@ defmodule GitRekt.Git do
 
   @doc """
   Returns a stream for the given revision `walk`.
+
+  Commits are walked in chunks growing from a single commit up to #{@revwalk_chunk_size} commits, so that taking
+  the first few elements of a stream restricted to a pathspec does not walk past them.
+
+  The stream halts early if walking fails, for example when a commit cannot be read from the object database.
   """
   @spec revwalk_stream(revwalk) :: {:ok, Enumerable.t} | {:error, term}
   def revwalk_stream(walk) do
-    {:ok, GitStream.new(walk, &revwalk_stream_next/1)}
+    {:ok, GitStream.new(walk, {walk, 1}, &revwalk_stream_next/1)}
   end
 
   @doc """
@@ -931,16 +1289,43 @@ defmodule GitRekt.Git do
 
   @doc """
   Returns a *PACK* file for the given `walk`.
+
+  Annotated tags in `oids` are included in the pack along with the objects the walk yields.
   """
-  @spec revwalk_pack(revwalk) :: {:ok, binary} | {:error, term}
-  def revwalk_pack(_walk) do
+  @spec revwalk_pack(revwalk, [oid]) :: {:ok, binary} | {:error, term}
+  def revwalk_pack(_walk, _oids \\ []) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Same as `revwalk_pack/2` but runs on the async worker pool (see `async_await/2`).
+
+  The job is cancelled if the `owner` process exits before it completes. Neither the `walk` nor its repository
+  may be used until the pack has been received, the pack being built from another thread.
+  """
+  @spec revwalk_pack_async(revwalk, [oid], pid) :: {:ok, reference} | {:error, term}
+  def revwalk_pack_async(_walk, _oids \\ [], _owner \\ self()) do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
   @doc """
   Returns a diff with the difference between two tree objects.
+
+  Following options are supported:
+
+  * `:pathspec` -- only include changes matching the given paths.
+  * `:context_lines` -- the number of unchanged lines around changes.
+  * `:interhunk_lines` -- the maximum number of unchanged lines between hunks before merging them.
+  * `:find_renames` -- detects renamed files.
+  * `:find_copies` -- detects copied files.
+  * `:rename_threshold` -- similarity (in percent) required to consider a file renamed, defaults to `50`.
+  * `:copy_threshold` -- similarity (in percent) required to consider a file copied, defaults to `50`.
+  * `:rename_limit` -- bounds the number of similarity comparisons, defaults to `1000`.
+
+  When the number of candidate pairs exceeds `:rename_limit` squared, only exact renames and copies are
+  detected. See `diff_find_limit_hit?/1`.
   """
-  @spec diff_tree(repo, tree, tree) :: {:ok, diff} | {:error, term}
+  @spec diff_tree(repo, tree, tree, keyword) :: {:ok, diff} | {:error, term}
   def diff_tree(_repo, _old_tree, _new_tree, _opts \\ []) do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
@@ -953,6 +1338,24 @@ defmodule GitRekt.Git do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Returns per-file stats for the given `diff`.
+
+  Each entry is a `{path, status, additions, deletions, binary?}` tuple, no hunk or line is built.
+  """
+  @spec diff_file_stats(diff) :: {:ok, [{binary, diff_status, non_neg_integer, non_neg_integer, boolean}]} | {:error, term}
+  def diff_file_stats(_diff) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns `true` if rename and copy detection was restricted to exact matches for the given `diff`.
+  """
+  @spec diff_find_limit_hit?(diff) :: boolean
+  def diff_find_limit_hit?(_diff) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns the number of deltas in the given `diff`.
   """
@@ -963,12 +1366,38 @@ defmodule GitRekt.Git do
 
   @doc """
   Returns a list of deltas for the given `diff`.
+
+  Line contents are sub-binaries of the old and new blob contents rather than copies, keeping any line
+  alive retains the whole blob.
   """
   @spec diff_deltas(diff) :: {:ok, [{diff_delta, [{diff_hunk, [diff_line]}]}]} | {:error, term}
   def diff_deltas(_diff) do
     raise Code.LoadError, file: nif_path() <> ".so"
   end
 
+  @doc """
+  Returns an iterator over the deltas of the given `diff`, starting at `offset`.
+
+  Files with more than `max_file_lines` lines or bigger than `max_file_size` bytes are not expanded; the latter
+  is checked before generating the patch. Once `max_lines` lines have been yielded, remaining deltas are not
+  expanded either, `lines` being the number of lines already yielded by previous iterators. Use `0` to disable
+  any limit.
+  """
+  @spec diff_iterator(diff, non_neg_integer, non_neg_integer, non_neg_integer, non_neg_integer, non_neg_integer) :: {:ok, diff_iter} | {:error, term}
+  def diff_iterator(_diff, _offset, _lines, _max_file_lines, _max_lines, _max_file_size) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
+  @doc """
+  Returns the next `count` deltas from the given `iter`.
+
+  Deltas exceeding the iterator line limits are returned with `:too_large` instead of their hunks.
+  """
+  @spec diff_iterator_next(diff_iter, pos_integer) :: {:ok, [{diff_delta, [{diff_hunk, [diff_line]}] | :too_large}]} | {:error, term}
+  def diff_iterator_next(_iter, _count) do
+    raise Code.LoadError, file: nif_path() <> ".so"
+  end
+
   @doc """
   Returns a binary represention of the given `diff`.
   """
@@ -1242,12 +1671,15 @@ defmodule GitRekt.Git do
     end
   end
 
-  defp revwalk_stream_next(walk) do
-    case revwalk_next(walk) do
-      {:ok, oid} ->
-        {[oid], walk}
-      {:error, :iterover} ->
-        {:halt, walk}
+  defp revwalk_stream_next(:iterover), do: {:halt, :iterover}
+  defp revwalk_stream_next({walk, max}) do
+    case revwalk_next_chunk(walk, max) do
+      {:ok, oids} ->
+        {oids, {walk, min(max * 2, @revwalk_chunk_size)}}
+      {:ok, oids, :iterover} ->
+        {oids, :iterover}
+      {:error, _reason} ->
+        {:halt, :iterover}
     end
   end
 
@@ -1268,5 +1700,27 @@ defmodule GitRekt.Git do
     end
   end
 
+  defp library_opts(opts) do
+    Map.new(opts, fn
+      {:cache_object_limits, limits} -> {:cache_object_limits, Map.new(limits)}
+      {key, val} -> {key, val}
+    end)
+  end
+
+  defp library_opts_check(opts) when map_size(opts) == 0, do: :ok
+  defp library_opts_check(opts) do
+    {:ok, current} = library_opts_get()
+    Enum.each(opts, fn
+      {key, _val} when not is_map_key(current, key) ->
+        Logger.warn("ignoring libgit2 option #{inspect key}: not supported by libgit2 #{Enum.join(Tuple.to_list(library_version()), ".")}")
+      {:cache_object_limits, limits} when is_map(limits) ->
+        unless Enum.all?(limits, fn {type, limit} -> current.cache_object_limits[type] == limit end),
+          do: Logger.warn("ignoring libgit2 option :cache_object_limits: invalid value #{inspect limits}")
+      {key, val} when val != :erlang.map_get(key, current) ->
+        Logger.warn("ignoring libgit2 option #{inspect key}: invalid value #{inspect val}")
+      {_key, _val} -> :ok
+    end)
+  end
+
   defp nif_path, do: Path.join(:code.priv_dir(:gitrekt), "geef_nif")
 end
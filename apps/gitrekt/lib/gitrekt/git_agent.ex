@@ -212,6 +212,17 @@ defmodule GitRekt.GitAgent do
   commit 171d3b53bdb83cf1a10ed96d79fcc703e3c7ee27
   ```
 
+  By default, the agent computes the next chunk only when the consumer asks for it. Passing the
+  `:stream_prefetch` option lets the agent compute up to the given number of chunks ahead, while the consumer
+  is still processing the current one:
+
+  ```
+  {:ok, stream} = GitAgent.history(agent, head, stream_prefetch: 2)
+  ```
+
+  Prefetched streams start with small chunks and adapt their size to the rate at which the consumer pulls
+  items, `:stream_chunk_size` becoming the upper bound.
+
   ## Garbage collector
 
   A small note about memory management and garbage collection.
@@ -244,6 +255,7 @@ defmodule GitRekt.GitAgent do
     GitIndex,
     GitIndexEntry,
     GitDiff,
+    GitDiffIterator,
     GitWritePack,
     GitStream,
     GitError
@@ -256,22 +268,35 @@ defmodule GitRekt.GitAgent do
   @type git_object :: GitCommit.t | GitBlob.t | GitTree.t | GitTag.t
   @type git_revision :: GitRef.t | GitTag.t | GitCommit.t
 
-  @default_config Map.new(
-    Application.compile_env(:gitrekt, __MODULE__, %{
+  @default_config Map.merge(
+    %{
       stream_chunk_size: 1_000,
+      stream_prefetch: 0,
       timeout: 5_000,
       idle_timeout: :infinity
-    })
+    },
+    Map.new(Application.compile_env(:gitrekt, __MODULE__, []))
   )
 
   @exec_opts [:timeout]
 
+  @reference_write_ops [:reference_create, :reference_delete, :reference_transaction, :commit_create]
+  @async_merge_ops [:merge_trees, :merge_commits]
+
+  @stream_min_chunk_size 16
+  @stream_chunk_usec 20_000
+
   @doc """
   Starts a Git agent linked to the current process for the repository at the given `path`.
+
+  When `:refdb_cache` is `true`, references are served from memory (see `GitRekt.Git.refdb_cache_enable/1`).
+  When `:shared_odb` is `true`, the object database (pack file maps and descriptors) is shared with the other agents
+  of the same repository, each agent still opening the rest of the repository on its own (see
+  `GitRekt.Git.repository_open_shared/1`).
   """
   @spec start_link(Path.t, keyword) :: GenServer.on_start
   def start_link(path, opts \\ []) do
-    {agent_opts, server_opts} = Keyword.split(opts, [:cache|Map.keys(@default_config)])
+    {agent_opts, server_opts} = Keyword.split(opts, [:cache, :refdb_cache, :shared_odb|Map.keys(@default_config)])
     GenServer.start_link(__MODULE__, {path, agent_opts}, server_opts)
   end
 
@@ -281,6 +306,12 @@ defmodule GitRekt.GitAgent do
   @spec empty?(agent, keyword) :: {:ok, boolean} | {:error, term}
   def empty?(agent, opts \\ []), do: exec(agent, :empty?, opts)
 
+  @doc """
+  Returns the absolute path of the repository.
+  """
+  @spec path(agent, keyword) :: {:ok, Path.t}
+  def path(agent, opts \\ []), do: exec(agent, :path, opts)
+
   @doc """
   Returns the ODB.
   """
@@ -323,6 +354,27 @@ defmodule GitRekt.GitAgent do
   @spec odb_writepack_commit(agent, GitWritePack.t, Git.odb_writepack_progress, keyword) :: {:ok, Git.odb_writepack_progress} | {:error, term}
   def odb_writepack_commit(agent, writepack, progress, opts \\ []), do: exec(agent, {:odb_writepack_commit, writepack, progress}, opts)
 
+  @doc """
+  Executes the given `cb` with objects being staged in memory.
+
+  The callback receives an agent for an in-memory repository. Objects written within the callback are flushed
+  into the ODB as a single PACK when `cb` returns `{:ok, result}`; they are discarded otherwise. Each batch adds a
+  pack to the ODB, objects of small writes, such as a single file edit, are better written loose.
+
+  References cannot be updated from within the callback; update them once the batch returns.
+
+  ```elixir
+  {:ok, commit_oid} = GitAgent.odb_batch(agent, fn batch ->
+    {:ok, odb} = GitAgent.odb(batch)
+    {:ok, blob_oid} = GitAgent.odb_write(batch, odb, "Hello world!\\n", :blob)
+    {:ok, tree_oid} = GitAgent.tree_update(batch, tree, [{:upsert, "README", blob_oid, 0o100644}])
+    GitAgent.commit_create(batch, author, committer, "Update README", tree_oid, [commit.oid])
+  end)
+  ```
+  """
+  @spec odb_batch(agent, (agent -> {:ok, term} | {:error, term}), keyword) :: {:ok, term} | {:error, term}
+  def odb_batch(agent, cb, opts \\ []), do: exec(agent, {:odb_batch, cb}, opts)
+
   @doc """
   Returns the Git reference for `HEAD`.
   """
@@ -401,6 +453,17 @@ defmodule GitRekt.GitAgent do
     else: exec(agent, {:references_with, with_target, glob, opts}, exec_opts)
   end
 
+  @doc """
+  Returns all Git references matching the given `glob` along with their peeled target.
+
+  The peeled target is only set for references pointing to an annotated tag, elsewise it is `nil`.
+  """
+  @spec references_peeled(agent, keyword) :: {:ok, [{GitRef.t, Git.oid | nil}]} | {:error, term}
+  def references_peeled(agent, opts \\ []) do
+    {glob, opts} = Keyword.pop(opts, :glob, :undefined)
+    exec(agent, {:references_peeled, glob}, opts)
+  end
+
   @doc """
   Returns the Git reference with the given `name`.
   """
@@ -427,12 +490,76 @@ defmodule GitRekt.GitAgent do
   @spec reference_delete(agent, binary, keyword) :: :ok | {:error, term}
   def reference_delete(agent, name, opts \\ []), do: exec(agent, {:reference_delete, name}, opts)
 
+  @doc """
+  Atomically applies the given reference `updates`.
+
+  Each update is a `{name, old_oid, new_oid}` tuple, where a `nil` old OID requires the reference not to exist
+  and a `nil` new OID deletes the reference. Either all the references are updated or none of them are, see
+  `GitRekt.Git.reference_transaction/2` for the limits of this guarantee on the filesystem backend.
+  """
+  @spec reference_transaction(agent, [Git.ref_update], keyword) :: :ok | {:error, term}
+  def reference_transaction(agent, updates, opts \\ []), do: exec(agent, {:reference_transaction, updates}, opts)
+
+  @doc """
+  Packs all the loose references into the `packed-refs` file.
+  """
+  @spec refdb_compress(agent, keyword) :: :ok | {:error, term}
+  def refdb_compress(agent, opts \\ []), do: exec(agent, :refdb_compress, opts)
+
   @doc """
   Returns the number of unique commits between two commit objects.
   """
   @spec graph_ahead_behind(agent, Git.oid, Git.oid, keyword) :: {:ok, {non_neg_integer, non_neg_integer}} | {:error, term}
   def graph_ahead_behind(agent, local, upstream, opts \\ []), do: exec(agent, {:graph_ahead_behind, local, upstream}, opts)
 
+  @doc """
+  Returns the number of unique commits between each of the `locals` commit objects and `upstream`.
+  """
+  @spec graph_ahead_behind_many(agent, Git.oid, [Git.oid], keyword) :: {:ok, [{non_neg_integer, non_neg_integer}]} | {:error, term}
+  def graph_ahead_behind_many(agent, upstream, locals, opts \\ []), do: exec(agent, {:graph_ahead_behind_many, upstream, locals}, opts)
+
+  @doc """
+  Returns a list of booleans telling whether `commit` is a descendant of each of the given `ancestors`.
+  """
+  @spec graph_descendant_of(agent, Git.oid, [Git.oid], keyword) :: {:ok, [boolean]} | {:error, term}
+  def graph_descendant_of(agent, commit, ancestors, opts \\ []), do: exec(agent, {:graph_descendant_of, commit, ancestors}, opts)
+
+  @doc """
+  Returns the best common ancestor of the commits `one` and `two`.
+  """
+  @spec merge_base(agent, Git.oid, Git.oid, keyword) :: {:ok, Git.oid} | {:error, term}
+  def merge_base(agent, one, two, opts \\ []), do: exec(agent, {:merge_base, one, two}, opts)
+
+  @doc """
+  Returns the best common ancestor of the given `oids`.
+
+  Pass `octopus: true` to get the common ancestor of all `oids` instead, suitable for an octopus merge.
+  """
+  @spec merge_base_many(agent, [Git.oid], keyword) :: {:ok, Git.oid} | {:error, term}
+  def merge_base_many(agent, oids, opts \\ []) do
+    {octopus, opts} = Keyword.pop(opts, :octopus, false)
+    exec(agent, {:merge_base_many, oids, octopus}, opts)
+  end
+
+  @doc """
+  Merges the trees `ours` and `theirs` given their common `ancestor` without touching the working directory.
+
+  Returns the OID of the merged tree, or the list of conflicting paths. Results are cached. When called on an agent
+  process, the merge runs on the async worker pool (see `GitRekt.Git.async_await/2`) so that the agent keeps
+  serving other requests meanwhile.
+  """
+  @spec merge_trees(agent, Git.oid | nil, Git.oid, Git.oid, keyword) :: {:ok, %{tree_oid: Git.oid | nil, conflicts: [Path.t]}} | {:error, term}
+  def merge_trees(agent, ancestor, ours, theirs, opts \\ []), do: exec(agent, {:merge_trees, ancestor, ours, theirs}, opts)
+
+  @doc """
+  Merges the commits `ours` and `theirs` without touching the working directory.
+
+  Returns the OID of the merged tree, or the list of conflicting paths. Results are cached. As for `merge_trees/5`,
+  the merge runs on the async worker pool when called on an agent process.
+  """
+  @spec merge_commits(agent, Git.oid, Git.oid, keyword) :: {:ok, %{tree_oid: Git.oid | nil, conflicts: [Path.t]}} | {:error, term}
+  def merge_commits(agent, ours, theirs, opts \\ []), do: exec(agent, {:merge_commits, ours, theirs}, opts)
+
   @doc """
   Returns the Git object with the given `oid`.
   """
@@ -546,6 +673,19 @@ defmodule GitRekt.GitAgent do
     else: exec(agent, {:tree_entries_with, with_target, revision, path, opts}, exec_opts)
   end
 
+  @doc """
+  Creates a new tree by applying the given `updates` to the tree of `revision`.
+
+  Each update is either `{:upsert, path, oid, mode}` or `{:remove, path}`. Only the trees along the updated
+  paths are rewritten, making this much cheaper than reading the whole tree into an index for small edits.
+
+  ```elixir
+  {:ok, tree_oid} = GitAgent.tree_update(agent, commit, [{:upsert, "lib/foo.ex", blob_oid, 0o100644}])
+  ```
+  """
+  @spec tree_update(agent, git_revision | GitTree.t, [Git.tree_update], keyword) :: {:ok, Git.oid} | {:error, term}
+  def tree_update(agent, revision, updates, opts \\ []), do: exec(agent, {:tree_update, revision, updates}, opts)
+
   @doc """
   Returns the Git index of the repository.
   """
@@ -596,9 +736,36 @@ defmodule GitRekt.GitAgent do
 
   @doc """
   Returns the deltas of the given `diff`.
+
+  By default, every delta is expanded into hunks and lines. In order to paginate large diffs, following
+  options are supported:
+
+  * `:offset` -- the index of the first delta to return.
+  * `:limit` -- the maximum number of deltas to return.
+  * `:max_file_lines` -- files with more lines are returned with `too_large: true` and no hunks.
+  * `:max_file_size` -- files bigger than the given number of bytes are returned with `too_large: true`, without being diffed.
+  * `:max_lines` -- the total number of lines to expand, remaining files are returned with `too_large: true`.
+
+  When given a `GitDiffIterator` (see `diff_deltas_iterator/3`), returns the next `:limit` deltas of the iterator.
   """
-  @spec diff_deltas(agent, GitDiff.t, keyword) :: {:ok, map} | {:error, term}
-  def diff_deltas(agent, diff, opts \\ []), do: exec(agent, {:diff_deltas, diff}, opts)
+  @spec diff_deltas(agent, GitDiff.t | GitDiffIterator.t, keyword) :: {:ok, [map]} | {:error, term}
+  def diff_deltas(agent, diff, opts \\ []) do
+    {exec_opts, opts} = pop_exec_opts(opts)
+    exec(agent, {:diff_deltas, diff, opts}, exec_opts)
+  end
+
+  @doc """
+  Returns an iterator over the deltas of the given `diff`.
+
+  Unlike `diff_deltas/3` with `:offset`, the iterator keeps track of the lines expanded so far, so the `:max_lines`
+  budget spans every page. Supports the same options as `diff_deltas/3`, plus `:lines` -- the number of lines
+  already expanded before `:offset`, when resuming from previously rendered deltas.
+  """
+  @spec diff_deltas_iterator(agent, GitDiff.t, keyword) :: {:ok, GitDiffIterator.t} | {:error, term}
+  def diff_deltas_iterator(agent, diff, opts \\ []) do
+    {exec_opts, opts} = pop_exec_opts(opts)
+    exec(agent, {:diff_deltas_iterator, diff, opts}, exec_opts)
+  end
 
   @doc """
   Returns a binary formated representation of the given `diff`.
@@ -615,6 +782,12 @@ defmodule GitRekt.GitAgent do
   @spec diff_stats(agent, GitDiff.t, keyword) :: {:ok, map} | {:error, term}
   def diff_stats(agent, diff, opts \\ []), do: exec(agent, {:diff_stats, diff}, opts)
 
+  @doc """
+  Returns the per-file stats of the given `diff`.
+  """
+  @spec diff_file_stats(agent, GitDiff.t, keyword) :: {:ok, [map]} | {:error, term}
+  def diff_file_stats(agent, diff, opts \\ []), do: exec(agent, {:diff_file_stats, diff}, opts)
+
   @doc """
   Returns the Git commit history of the given `revision`.
   """
@@ -635,6 +808,10 @@ defmodule GitRekt.GitAgent do
 
   @doc """
   Returns a Git PACK representation of the given `oids`.
+
+  When `agent` is a process, the pack is built on the async worker pool (see `GitRekt.Git.async_await/2`) and the
+  agent keeps serving other requests meanwhile. The pack is built from a repository handle of its own, and is
+  cancelled if the calling process exits before it is done.
   """
   @spec pack_create(agent, [Git.oid], keyword) :: {:ok, binary} | {:error, term}
   def pack_create(agent, oids, opts \\ []), do: exec(agent, {:pack, oids}, opts)
@@ -647,18 +824,27 @@ defmodule GitRekt.GitAgent do
     exec(agent, {:transaction, name, cb}, opts)
   end
 
+  @doc """
+  Removes the cached result of the transaction with the given `name`.
+  """
+  @spec invalidate(agent, term, keyword) :: :ok
+  def invalidate(agent, name, opts \\ []), do: exec(agent, {:invalidate, name}, opts)
+
   #
   # Callbacks
   #
 
   @impl true
   def init({path, opts}) do
-    case Git.repository_open(path) do
-      {:ok, handle} ->
-        config = Map.merge(@default_config, Map.new(opts))
-        config = Map.put(config, :mon, %{})
-        config = Map.put_new_lazy(config, :cache, fn -> init_cache(path, []) end)
-        {:ok, {handle, config}, config.idle_timeout}
+    with {:ok, handle} <- init_repository(path, Keyword.get(opts, :shared_odb, false)),
+         :ok <- init_refdb(handle, Keyword.get(opts, :refdb_cache, false)) do
+      config = Map.merge(@default_config, Map.new(opts))
+      config = Map.put(config, :mon, %{})
+      config = Map.put(config, :jobs, %{})
+      config = Map.put(config, :streams, %{})
+      config = Map.put_new_lazy(config, :cache, fn -> cache_adapter().init_cache(path, []) end)
+      {:ok, {handle, config}, config.idle_timeout}
+    else
       {:error, reason} ->
         {:stop, reason}
     end
@@ -683,11 +869,18 @@ defmodule GitRekt.GitAgent do
     :ok
   end
 
+  @impl true
+  def delete_cache(cache, op) when not is_nil(op) do
+    :ets.delete(cache, op)
+    :ok
+  end
+
   @impl true
   def handle_call(op, {pid, _tag}, {handle, config} = state) when elem(op, 0) in [:references, :references_with, :history, :tree_entries, :tree_entries_with, :commit_parents] do
     opts_index = tuple_size(op) - 1
     {chunk_size, opts} = Keyword.pop(elem(op, opts_index), :stream_chunk_size, config.stream_chunk_size)
-    case call_stream(handle, put_elem(op, opts_index, opts), chunk_size, pid) do
+    {prefetch, opts} = Keyword.pop(opts, :stream_prefetch, config.stream_prefetch)
+    case call_stream(handle, put_elem(op, opts_index, opts), chunk_size, prefetch, pid) do
       {:ok, stream} ->
         {:reply, {:ok, stream}, {handle, collect_result_refs(config, stream, pid)}, config.idle_timeout}
       {:error, reason} ->
@@ -700,6 +893,43 @@ defmodule GitRekt.GitAgent do
     {:reply, {head, tail}, {handle, collect_result_refs(config, head, pid)}, config.idle_timeout}
   end
 
+  def handle_call({:stream_prefetch, op, stream, chunk_size, credits}, {pid, _tag}, {handle, config} = _state) do
+    ref = make_ref()
+    send(self(), {:stream_produce, ref})
+    config = collect_result_refs(config, [], pid)
+    config = Map.update!(config, :streams, &Map.put(&1, ref, %{op: op, tail: stream, chunk_size: chunk_size, credits: credits, pid: pid}))
+    {:reply, {:ok, ref}, {handle, config}, config.idle_timeout}
+  end
+
+  def handle_call({:stream_cancel, ref}, _from, {handle, config} = _state) do
+    {:reply, :ok, {handle, Map.update!(config, :streams, &Map.delete(&1, ref))}, config.idle_timeout}
+  end
+
+  def handle_call({:pack, oids} = op, {pid, _tag} = from, {handle, config} = state) do
+    case pack_async(handle, oids, pid, config) do
+      {:ok, ref} ->
+        {:noreply, {handle, Map.update!(config, :jobs, &Map.put(&1, ref, {from, op, :os.system_time(:microsecond)}))}, config.idle_timeout}
+      {:error, reason} ->
+        {:reply, {:error, reason}, state, config.idle_timeout}
+    end
+  end
+
+  def handle_call(op, {pid, _tag} = from, {handle, %{cache: cache} = config} = state) when elem(op, 0) in @async_merge_ops do
+    event_time = :os.system_time(:microsecond)
+    cache_key = cache_adapter().make_cache_key(op)
+    if cache_result = cache_adapter().fetch_cache(cache, cache_key) do
+      telemetry(:execute, op, %{duration: :os.system_time(:microsecond) - event_time}, %{cache: cache_key, pid: pid})
+      {:reply, {:ok, cache_result}, state, config.idle_timeout}
+    else
+      case merge_async(handle, op, pid, config) do
+        {:ok, ref} ->
+          {:noreply, {handle, Map.update!(config, :jobs, &Map.put(&1, ref, {from, op, event_time}))}, config.idle_timeout}
+        {:error, reason} ->
+          {:reply, {:error, reason}, state, config.idle_timeout}
+      end
+    end
+  end
+
   def handle_call(op, {pid, _tag}, {handle, %{cache: cache} = config} = state) do
     case call_cache(handle, op, cache, pid) do
       :ok ->
@@ -711,9 +941,47 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  @impl true
+  def handle_cast({:stream_ack, ref, chunk_size}, {handle, config} = state) do
+    case Map.fetch(config.streams, ref) do
+      {:ok, stream} ->
+        if stream.credits == 0, do: send(self(), {:stream_produce, ref})
+        {:noreply, {handle, put_in(config, [:streams, ref], %{stream|credits: stream.credits + 1, chunk_size: chunk_size})}, config.idle_timeout}
+      :error ->
+        {:noreply, state, config.idle_timeout}
+    end
+  end
+
   @impl true
   def handle_info({:DOWN, _ref, :process, pid, _reason}, {handle, config} = _state) do
-    {:noreply, {handle, Map.update!(config, :mon, &Map.delete(&1, pid))}, config.idle_timeout}
+    config = Map.update!(config, :mon, &Map.delete(&1, pid))
+    config = Map.update!(config, :streams, &Map.new(Enum.reject(&1, fn {_ref, stream} -> stream.pid == pid end)))
+    {:noreply, {handle, config}, config.idle_timeout}
+  end
+
+  def handle_info({:stream_produce, ref}, {handle, config} = state) do
+    case Map.fetch(config.streams, ref) do
+      {:ok, %{credits: credits} = stream} when credits > 0 ->
+        {head, tail} = call_stream_next(stream.op, stream.tail, stream.chunk_size, stream.pid)
+        config = collect_result_refs(config, head, stream.pid)
+        if tail == :halt do
+          send(stream.pid, {:git_stream, ref, head, :halt})
+          {:noreply, {handle, Map.update!(config, :streams, &Map.delete(&1, ref))}, config.idle_timeout}
+        else
+          send(stream.pid, {:git_stream, ref, head, :cont})
+          if credits > 1, do: send(self(), {:stream_produce, ref})
+          {:noreply, {handle, put_in(config, [:streams, ref], %{stream|tail: tail, credits: credits - 1})}, config.idle_timeout}
+        end
+      _ ->
+        {:noreply, state, config.idle_timeout}
+    end
+  end
+
+  def handle_info({:geef_async, ref, result}, {handle, config} = _state) do
+    {{from, op, event_time}, jobs} = Map.pop(config.jobs, ref)
+    GenServer.reply(from, async_result(op, result, config.cache, event_time, from))
+    telemetry_memory(handle)
+    {:noreply, {handle, %{config|jobs: jobs}}, config.idle_timeout}
   end
 
   def handle_info(:timeout, {_handle, %{idle_timeout: :infinity}} = state) do
@@ -726,6 +994,8 @@ defmodule GitRekt.GitAgent do
 
   @impl true
   def make_cache_key({:transaction, name, _cb} = _op) when not is_nil(name), do:  name
+  def make_cache_key({:merge_trees, ancestor, ours, theirs} = _op), do: {:merge_trees, ancestor, ours, theirs}
+  def make_cache_key({:merge_commits, ours, theirs} = _op), do: {:merge_commits, ours, theirs}
   def make_cache_key(_op), do: nil
 
   #
@@ -744,12 +1014,22 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  defp init_repository(path, true), do: Git.repository_open_shared(path)
+  defp init_repository(path, false), do: Git.repository_open(path)
+
+  defp init_refdb(handle, true), do: Git.refdb_cache_enable(handle)
+  defp init_refdb(_handle, false), do: :ok
+
   defp pop_exec_opts(opts), do: Enum.split_with(opts, fn {k, _v} -> k in @exec_opts end)
 
   defp call(handle, :empty?) do
     {:ok, Git.repository_empty?(handle)}
   end
 
+  defp call(handle, :path) do
+    {:ok, Git.repository_get_path(handle)}
+  end
+
   defp call(handle, :head) do
     case Git.reference_resolve(handle, "HEAD") do
       {:ok, name, shorthand, oid} ->
@@ -760,9 +1040,28 @@ defmodule GitRekt.GitAgent do
   end
 
   defp call(handle, {:references, glob, opts}) do
-    case Git.reference_stream(handle, glob) do
-      {:ok, stream} ->
-        {:ok, Stream.map(stream, &resolve_reference_peel!(&1, Keyword.get(opts, :target, :undefined), handle))}
+    case Keyword.get(opts, :target, :undefined) do
+      target when target in [:undefined, :commit] ->
+        case Git.reference_list_full(handle, glob) do
+          {:ok, refs} ->
+            {:ok, Enum.map(refs, &resolve_reference_peeled(&1, target))}
+          {:error, reason} ->
+            {:error, reason}
+        end
+      target ->
+        case Git.reference_stream(handle, glob) do
+          {:ok, stream} ->
+            {:ok, Stream.map(stream, &resolve_reference_peel!(&1, target, handle))}
+          {:error, reason} ->
+            {:error, reason}
+        end
+    end
+  end
+
+  defp call(handle, {:references_peeled, glob}) do
+    case Git.reference_list_full(handle, glob) do
+      {:ok, refs} ->
+        {:ok, Enum.map(refs, &{resolve_reference_peeled(&1, :undefined), elem(&1, 4)})}
       {:error, reason} ->
         {:error, reason}
     end
@@ -813,6 +1112,8 @@ defmodule GitRekt.GitAgent do
 
   defp call(handle, {:reference_create, name, type, target, force}), do: Git.reference_create(handle, name, type, target, force)
   defp call(handle, {:reference_delete, name}), do: Git.reference_delete(handle, name)
+  defp call(handle, {:reference_transaction, updates}), do: Git.reference_transaction(handle, updates)
+  defp call(handle, :refdb_compress), do: Git.refdb_compress(handle)
   defp call(handle, {:revision, spec}) do
     case Git.revparse_ext(handle, spec) do
       {:ok, obj, obj_type, oid, name} ->
@@ -831,6 +1132,31 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  defp call(handle, {:graph_ahead_behind_many, upstream, locals}), do: Git.graph_ahead_behind_many(handle, upstream, locals)
+  defp call(handle, {:graph_descendant_of, commit, ancestors}), do: Git.graph_descendant_of(handle, commit, ancestors)
+
+  defp call(handle, {:merge_base, one, two}), do: Git.merge_base(handle, one, two)
+  defp call(handle, {:merge_base_many, oids, false}), do: Git.merge_base_many(handle, oids)
+  defp call(handle, {:merge_base_many, oids, true}), do: Git.merge_base_octopus(handle, oids)
+
+  defp call(handle, {:merge_trees, ancestor, ours, theirs}) do
+    case Git.merge_trees(handle, ancestor, ours, theirs) do
+      {:ok, tree_oid, conflicts} ->
+        {:ok, %{tree_oid: tree_oid, conflicts: conflicts}}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
+  defp call(handle, {:merge_commits, ours, theirs}) do
+    case Git.merge_commits(handle, ours, theirs) do
+      {:ok, tree_oid, conflicts} ->
+        {:ok, %{tree_oid: tree_oid, conflicts: conflicts}}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
   defp call(handle, :odb) do
     case Git.repository_get_odb(handle) do
       {:ok, odb} ->
@@ -870,6 +1196,23 @@ defmodule GitRekt.GitAgent do
   end
 
   defp call(_handle, {:odb_writepack_commit, %GitWritePack{__ref__: writepack}, progress}), do: Git.odb_writepack_commit(writepack, progress)
+  defp call(handle, {:odb_batch, cb}) do
+    with {:ok, batch, mempack} <- Git.mempack_new(handle) do
+      try do
+        case cb.(batch) do
+          {:ok, result} ->
+            with {:ok, _count} <- Git.mempack_flush(mempack, handle), do: {:ok, result}
+          {:error, reason} ->
+            {:error, reason}
+        end
+      rescue
+        error in GitError ->
+          {:error, error}
+      after
+        Git.mempack_reset(mempack)
+      end
+    end
+  end
   defp call(handle, {:object, oid}) do
     case Git.object_lookup(handle, oid) do
       {:ok, obj_type, obj} ->
@@ -940,12 +1283,17 @@ defmodule GitRekt.GitAgent do
       {:ok, Stream.transform(commits, {root_tree_entry, Map.new(tree_entries, &{Path.join(path, &1.name), &1})}, &zip_tree_entries_target(with_target, &1, &2, handle))}
   end
 
+  defp call(handle, {:tree_update, obj, updates}) do
+    with {:ok, %GitTree{__ref__: tree}} <- fetch_tree(obj, handle), do:
+      Git.tree_update(handle, tree, updates)
+  end
+
   defp call(_handle, {:blob_content, %GitBlob{__ref__: blob}}), do: Git.blob_content(blob)
   defp call(_handle, {:blob_size, %GitBlob{__ref__: blob}}), do: Git.blob_size(blob)
 
   defp call(handle, {:diff, obj1, obj2, opts}), do: fetch_diff(obj1, obj2, handle, opts)
   defp call(_handle, {:diff_format, %GitDiff{__ref__: diff}, format}), do: Git.diff_format(diff, format)
-  defp call(_handle, {:diff_deltas, %GitDiff{__ref__: diff}}) do
+  defp call(_handle, {:diff_deltas, %GitDiff{__ref__: diff}, []}) do
     case Git.diff_deltas(diff) do
       {:ok, deltas} ->
         {:ok, Enum.map(deltas, &resolve_diff_delta/1)}
@@ -954,10 +1302,38 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  defp call(_handle, {:diff_deltas, %GitDiff{__ref__: diff}, opts}) do
+    with {:ok, iter} <- fetch_diff_iterator(diff, opts),
+         {:ok, limit} <- fetch_diff_deltas_limit(diff, opts), do:
+      fetch_diff_deltas(iter, limit)
+  end
+
+  defp call(_handle, {:diff_deltas, %GitDiffIterator{__ref__: iter}, opts}) do
+    fetch_diff_deltas(iter, Keyword.get(opts, :limit, 1_000))
+  end
+
+  defp call(_handle, {:diff_deltas_iterator, %GitDiff{__ref__: diff}, opts}) do
+    case fetch_diff_iterator(diff, opts) do
+      {:ok, iter} ->
+        {:ok, %GitDiffIterator{__ref__: iter}}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
   defp call(_handle, {:diff_stats, %GitDiff{__ref__: diff}}) do
     case Git.diff_stats(diff) do
       {:ok, files_changed, insertions, deletions} ->
-        {:ok, resolve_diff_stats({files_changed, insertions, deletions})}
+        {:ok, resolve_diff_stats({files_changed, insertions, deletions, Git.diff_find_limit_hit?(diff)})}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
+  defp call(_handle, {:diff_file_stats, %GitDiff{__ref__: diff}}) do
+    case Git.diff_file_stats(diff) do
+      {:ok, stats} ->
+        {:ok, Enum.map(stats, &resolve_diff_file_stats/1)}
       {:error, reason} ->
         {:error, reason}
     end
@@ -1012,9 +1388,12 @@ defmodule GitRekt.GitAgent do
   defp call(handle, {:history, rev, opts}), do: walk_history(rev, handle, opts)
   defp call(handle, {:peel, obj, target}), do: fetch_target(obj, target, handle)
   defp call(handle, {:pack, oids}) do
-    with {:ok, walk} <- Git.revwalk_new(handle),
-          :ok <- walk_insert(walk, oid_mask(oids)),
-      do: Git.revwalk_pack(walk)
+    result =
+      with {:ok, walk} <- Git.revwalk_new(handle),
+            :ok <- walk_insert(walk, oid_mask(oids)),
+        do: Git.revwalk_pack(walk, for({oid, false} <- oid_mask(oids), do: oid))
+    telemetry_memory(handle)
+    result
   end
 
   defp call(handle, {:transaction, _name, cb}) do
@@ -1026,6 +1405,8 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  defp call(_handle, {:invalidate, _name}), do: :ok
+
   defp call(_handle, op), do: {:error, %GitError{message: "invalid operation #{inspect op}", code: -21}}
 
   defp call_cache(handle, op, cache), do: call_cache(handle, op, cache, self())
@@ -1038,8 +1419,23 @@ defmodule GitRekt.GitAgent do
     result
   end
 
+  defp call_cache(_handle, {:invalidate, name} = op, cache, pid) do
+    telemetry(:execute, op, fn -> cache_adapter().delete_cache(cache, name) end, %{pid: pid})
+  end
+
+  defp call_cache(handle, op, cache, pid) when elem(op, 0) in @reference_write_ops do
+    case telemetry(:execute, op, fn -> call(handle, op) end, %{pid: pid}) do
+      {:error, reason} ->
+        {:error, reason}
+      result ->
+        # the reference advertisement (see `GitRekt.WireProtocol.reference_discovery/3`) is stale now
+        cache_adapter().delete_cache(cache, :reference_discovery)
+        result
+    end
+  end
+
   defp call_cache(handle, op, cache, pid) do
-    cache_adapter = Keyword.get(Application.get_env(:gitrekt, __MODULE__, []), :cache_adapter, __MODULE__)
+    cache_adapter = cache_adapter()
     if cache_key = cache_adapter.make_cache_key(op) do
       event_time = :os.system_time(:microsecond)
       if cache_result = cache_adapter.fetch_cache(cache, cache_key) do
@@ -1063,13 +1459,17 @@ defmodule GitRekt.GitAgent do
     end
   end
 
-  defp call_stream(handle, op, chunk_size, pid) do
+  defp cache_adapter, do: Keyword.get(Application.get_env(:gitrekt, __MODULE__, []), :cache_adapter, __MODULE__)
+
+  defp call_stream(handle, op, chunk_size, prefetch, pid) do
     telemetry(:execute, op, fn ->
       case call(handle, op) do
+        {:ok, list} when is_list(list) ->
+          {:ok, list}
         {:ok, stream} ->
           if chunk_size == :infinity,
             do: {:ok, Enum.to_list(stream)},
-          else: {:ok, async_stream(op, stream, chunk_size, pid)}
+          else: {:ok, async_stream(op, stream, chunk_size, prefetch, pid)}
         {:error, reason} ->
           {:error, reason}
       end
@@ -1094,6 +1494,14 @@ defmodule GitRekt.GitAgent do
     else: {head, :halt}
   end
 
+  defp telemetry_memory(handle) do
+    {:ok, stats} = Git.library_memory_stats()
+    {:ok, repository} = Git.repository_memory(handle)
+    measurements = Map.merge(Map.take(stats, [:total, :peak, :failures]), stats.categories)
+    measurements = Map.put(measurements, :repository, repository)
+    :telemetry.execute([:gitrekt, :library, :memory], measurements, %{soft_limit: stats.memory_soft_limit})
+  end
+
   defp telemetry(event_name, op, measurements, meta) when is_map(measurements) do
     {name, args} = map_operation(op)
     :telemetry.execute([:gitrekt, :git_agent, event_name], measurements, Map.merge(%{op: name, args: args}, meta))
@@ -1139,6 +1547,16 @@ defmodule GitRekt.GitAgent do
     %GitRef{oid: oid, name: shorthand, prefix: prefix, type: resolve_reference_type(prefix)}
   end
 
+  # tags annotating a tree or a blob can not be peeled to a commit, their direct target is kept
+  defp resolve_reference_peeled({name, shorthand, type, oid, peeled, :commit}, :commit) do
+    case resolve_reference({name, shorthand, type, oid}) do
+      %GitRef{type: :tag} = ref -> struct(ref, oid: peeled)
+      ref -> ref
+    end
+  end
+
+  defp resolve_reference_peeled({name, shorthand, type, oid, _peeled, _peeled_type}, _target), do: resolve_reference({name, shorthand, type, oid})
+
   defp resolve_reference_type("refs/heads/"), do: :branch
   defp resolve_reference_type("refs/tags/"), do: :tag
 
@@ -1178,8 +1596,12 @@ defmodule GitRekt.GitAgent do
 
   defp resolve_index(index), do: %GitIndex{__ref__: index}
 
-  defp resolve_diff_delta({{old_file, new_file, count, similarity}, hunks}) do
-    %{old_file: resolve_diff_file(old_file), new_file: resolve_diff_file(new_file), count: count, similarity: similarity, hunks: Enum.map(hunks, &resolve_diff_hunk/1)}
+  defp resolve_diff_delta({{old_file, new_file, status, count, similarity}, :too_large}) do
+    %{old_file: resolve_diff_file(old_file), new_file: resolve_diff_file(new_file), status: status, count: count, similarity: similarity, hunks: [], too_large: true}
+  end
+
+  defp resolve_diff_delta({{old_file, new_file, status, count, similarity}, hunks}) do
+    %{old_file: resolve_diff_file(old_file), new_file: resolve_diff_file(new_file), status: status, count: count, similarity: similarity, hunks: Enum.map(hunks, &resolve_diff_hunk/1), too_large: false}
   end
 
   defp resolve_diff_file({oid, path, size, mode}) do
@@ -1194,8 +1616,12 @@ defmodule GitRekt.GitAgent do
     %{origin: <<origin>>, old_line_no: old_line_no, new_line_no: new_line_no, num_lines: num_lines, content_offset: content_offset, content: content}
   end
 
-  defp resolve_diff_stats({files_changed, insertions, deletions}) do
-    %{files_changed: files_changed, insertions: insertions, deletions: deletions}
+  defp resolve_diff_file_stats({path, status, additions, deletions, binary}) do
+    %{path: path, status: status, additions: additions, deletions: deletions, binary: binary}
+  end
+
+  defp resolve_diff_stats({files_changed, insertions, deletions, rename_limit_hit}) do
+    %{files_changed: files_changed, insertions: insertions, deletions: deletions, rename_limit_hit: rename_limit_hit}
   end
 
   defp lookup_object!(oid, handle) do
@@ -1224,6 +1650,7 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  defp fetch_tree(%GitTree{} = tree, _handle), do: {:ok, tree}
   defp fetch_tree(%GitCommit{__ref__: commit}, _handle) do
     case Git.commit_tree(commit) do
       {:ok, oid, tree} ->
@@ -1338,6 +1765,33 @@ defmodule GitRekt.GitAgent do
 
   defp zip_tree_entries_target(_with_target, _commit, path_map, _handle), do: {:halt, path_map}
 
+  defp fetch_diff_iterator(diff, opts) do
+    offset = Keyword.get(opts, :offset, 0)
+    lines = Keyword.get(opts, :lines, 0)
+    max_file_lines = Keyword.get(opts, :max_file_lines, 0)
+    max_lines = Keyword.get(opts, :max_lines, 0)
+    max_file_size = Keyword.get(opts, :max_file_size, 0)
+    Git.diff_iterator(diff, offset, lines, max_file_lines, max_lines, max_file_size)
+  end
+
+  defp fetch_diff_deltas(iter, limit) do
+    case Git.diff_iterator_next(iter, limit) do
+      {:ok, deltas} ->
+        {:ok, Enum.map(deltas, &resolve_diff_delta/1)}
+      {:error, :iterover} ->
+        {:ok, []}
+      {:error, reason} ->
+        {:error, reason}
+    end
+  end
+
+  defp fetch_diff_deltas_limit(diff, opts) do
+    case Keyword.fetch(opts, :limit) do
+      {:ok, limit} -> {:ok, limit}
+      :error -> Git.diff_delta_count(diff)
+    end
+  end
+
   defp fetch_diff(%GitTree{__ref__: tree1}, %GitTree{__ref__: tree2}, handle, opts) do
     case Git.diff_tree(handle, tree1, tree2, opts) do
       {:ok, diff} ->
@@ -1431,19 +1885,16 @@ defmodule GitRekt.GitAgent do
     {sorting, opts} = Enum.split_with(opts, &(is_atom(&1) && String.starts_with?(to_string(&1), "sort")))
     with {:ok, walk} <- Git.revwalk_new(handle),
           :ok <- Git.revwalk_sorting(walk, sorting),
+          :ok <- Git.revwalk_pathspec(walk, List.wrap(Keyword.get(opts, :pathspec, []))),
          {:ok, commit} <- fetch_target(rev, :commit, handle),
           :ok <- Git.revwalk_push(walk, commit.oid),
          {:ok, stream} <- Git.revwalk_stream(walk) do
-      stream =
-        case Keyword.get(opts, :target, :commit) do
-          :commit_oid ->
-            stream
-          :commit ->
-            Stream.map(stream, &lookup_object!(&1, handle))
-        end
-      if pathspec = Keyword.get(opts, :pathspec),
-        do: {:ok, Stream.filter(stream, &pathspec_match_commit(&1, List.wrap(pathspec), handle))},
-      else: {:ok, stream}
+      case Keyword.get(opts, :target, :commit) do
+        :commit_oid ->
+          {:ok, stream}
+        :commit ->
+          {:ok, Stream.map(stream, &lookup_object!(&1, handle))}
+      end
     end
   end
 
@@ -1480,6 +1931,35 @@ defmodule GitRekt.GitAgent do
     end
   end
 
+  # async jobs run on a worker thread while the agent keeps using its own handle
+  defp job_repository(handle, config), do: init_repository(Git.repository_get_path(handle), Map.get(config, :shared_odb, false))
+
+  defp pack_async(handle, oids, owner, config) do
+    with {:ok, repo} <- job_repository(handle, config),
+         {:ok, walk} <- Git.revwalk_new(repo),
+          :ok <- walk_insert(walk, oid_mask(oids)),
+      do: Git.revwalk_pack_async(walk, for({oid, false} <- oid_mask(oids), do: oid), owner)
+  end
+
+  defp merge_async(handle, {:merge_trees, ancestor, ours, theirs}, owner, config) do
+    with {:ok, repo} <- job_repository(handle, config), do:
+      Git.merge_trees_async(repo, ancestor, ours, theirs, owner)
+  end
+
+  defp merge_async(handle, {:merge_commits, ours, theirs}, owner, config) do
+    with {:ok, repo} <- job_repository(handle, config), do:
+      Git.merge_commits_async(repo, ours, theirs, owner)
+  end
+
+  defp async_result(op, {:ok, tree_oid, conflicts}, cache, event_time, {pid, _tag}) when elem(op, 0) in @async_merge_ops do
+    result = %{tree_oid: tree_oid, conflicts: conflicts}
+    telemetry(:execute, op, %{duration: :os.system_time(:microsecond) - event_time}, %{pid: pid})
+    cache_adapter().put_cache(cache, cache_adapter().make_cache_key(op), result)
+    {:ok, result}
+  end
+
+  defp async_result(_op, result, _cache, _event_time, _from), do: result
+
   defp oid_mask(oids) do
     Enum.map(oids, fn
       {oid, hidden} when is_binary(oid) -> {oid, hidden}
@@ -1499,7 +1979,21 @@ defmodule GitRekt.GitAgent do
     end
   end
 
-  defp async_stream(op, stream, chunk_size, pid) do
+  defp async_stream(op, stream, chunk_size, prefetch, pid) when prefetch > 0 do
+    agent = self()
+    GitStream.transform(stream, fn
+      :halt ->
+        {:halt, :halt}
+      %{ref: _ref} = acc ->
+        prefetch_stream_next(agent, op, acc)
+      stream ->
+        if agent == self(),
+          do: call_stream_next(op, stream, chunk_size, pid),
+        else: prefetch_stream_next(agent, op, prefetch_stream_start(agent, op, stream, chunk_size, prefetch))
+    end, &prefetch_stream_cancel(agent, &1))
+  end
+
+  defp async_stream(op, stream, chunk_size, _prefetch, pid) do
     agent = self()
     GitStream.transform(stream, fn
       :halt ->
@@ -1511,6 +2005,59 @@ defmodule GitRekt.GitAgent do
     end)
   end
 
+  defp prefetch_stream_start(agent, op, stream, max_chunk_size, prefetch) do
+    chunk_size = min(max_chunk_size, @stream_min_chunk_size)
+    {:ok, ref} = GenServer.call(agent, {:stream_prefetch, op, stream, chunk_size, prefetch + 1}, @default_config.timeout)
+    %{ref: ref, mon: Process.monitor(agent), chunk_size: chunk_size, max_chunk_size: max_chunk_size, time: nil, size: 0}
+  end
+
+  defp prefetch_stream_next(agent, op, acc) do
+    telemetry(:call_stream, op, fn ->
+      receive do
+        {:git_stream, ref, head, :halt} when ref == acc.ref ->
+          Process.demonitor(acc.mon, [:flush])
+          {head, :halt}
+        {:git_stream, ref, head, :cont} when ref == acc.ref ->
+          acc = prefetch_stream_adapt(acc, length(head))
+          GenServer.cast(agent, {:stream_ack, acc.ref, acc.chunk_size})
+          {head, acc}
+        {:DOWN, mon, :process, _pid, reason} when mon == acc.mon ->
+          exit({reason, {__MODULE__, :stream_next, [agent, op]}})
+      after
+        @default_config.timeout ->
+          prefetch_stream_cancel(agent, acc)
+          exit({:timeout, {__MODULE__, :stream_next, [agent, op]}})
+      end
+    end, %{stream_chunk_size: acc.chunk_size, stream_prefetch: true, pid: agent})
+  end
+
+  defp prefetch_stream_adapt(%{time: nil} = acc, size), do: %{acc|time: System.monotonic_time(:microsecond), size: size}
+  defp prefetch_stream_adapt(acc, size) do
+    time = System.monotonic_time(:microsecond)
+    chunk_size = div(acc.size * @stream_chunk_usec, max(time - acc.time, 1))
+    %{acc|time: time, size: size, chunk_size: chunk_size |> min(acc.max_chunk_size) |> max(@stream_min_chunk_size)}
+  end
+
+  defp prefetch_stream_cancel(agent, %{ref: ref, mon: mon}) do
+    Process.demonitor(mon, [:flush])
+    try do
+      GenServer.call(agent, {:stream_cancel, ref}, @default_config.timeout)
+    catch
+      :exit, _reason -> :ok
+    end
+    prefetch_stream_flush(ref)
+  end
+
+  defp prefetch_stream_cancel(_agent, _acc), do: :ok
+
+  defp prefetch_stream_flush(ref) do
+    receive do
+      {:git_stream, ^ref, _head, _status} -> prefetch_stream_flush(ref)
+    after
+      0 -> :ok
+    end
+  end
+
   defp map_operation(op) when is_atom(op), do: {op, []}
   defp map_operation(op) do
     [name|args] = Tuple.to_list(op)
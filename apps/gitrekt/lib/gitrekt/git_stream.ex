@@ -17,10 +17,12 @@ defmodule GitRekt.GitStream do
 
   @doc """
   Transforms the given `stream`.
+
+  The optional `after_fun` is invoked with the last accumulator when the stream halts.
   """
-  @spec transform(Enumerable.t, (Stream.acc -> {[Stream.element], Stream.acc} | {:halt, Stream.acc})) :: t
-  def transform(%Stream{enum: %__MODULE__{enum: enum, __ref__: ref}} = stream, next_fun) do
-    %__MODULE__{enum: struct(stream, enum: Stream.resource(fn -> enum end, next_fun, &after_fun/1)), __ref__: ref}
+  @spec transform(Enumerable.t, (Stream.acc -> {[Stream.element], Stream.acc} | {:halt, Stream.acc}), (Stream.acc -> term)) :: t
+  def transform(%Stream{enum: %__MODULE__{enum: enum, __ref__: ref}} = stream, next_fun, after_fun \\ &after_fun/1) do
+    %__MODULE__{enum: struct(stream, enum: Stream.resource(fn -> enum end, next_fun, after_fun)), __ref__: ref}
   end
 
   #
@@ -19,7 +19,7 @@ defmodule GitRekt.WireProtocol do
   alias GitRekt.GitRef
 
   @upload_caps ~w(multi_ack multi_ack_detailed)
-  @receive_caps ~w(report-status delete-refs)
+  @receive_caps ~w(report-status delete-refs atomic)
 
   @doc """
   Callback used to transist a service to the next step.
@@ -97,17 +97,27 @@ defmodule GitRekt.WireProtocol do
 
   @doc """
   Returns a stream describing each ref and it current value.
+
+  The advertisement is cached by the agent. References written through `GitRekt.GitAgent` or by `receive-pack`
+  discard it explicitly (see `reference_discovery_reset/1`). Changes made by other writers are detected by looking
+  at `HEAD`, `packed-refs` and the top-level ref directories, without listing every loose ref.
   """
   @spec reference_discovery(GitAgent.agent, binary, [binary]) :: iolist
   def reference_discovery(agent, service, extra_capabilities \\ []) do
-    {:ok, refs} = GitAgent.references(agent, target: :commit, stream_chunk_size: :infinity)
-    [reference_head(agent)|Enum.to_list(refs)]
-    |> List.flatten()
-    |> Enum.map(&format_ref_line/1)
-    |> List.update_at(0, &(&1 <> "\0" <> Enum.join(server_capabilities(service) ++ extra_capabilities, " ")))
-    |> Enum.concat([:flush])
+    case reference_advertisement(agent) do
+      {first_line, lines} ->
+        [first_line <> "\0" <> Enum.join(server_capabilities(service) ++ extra_capabilities, " "), {:encoded, lines}, :flush]
+      nil ->
+        [:flush]
+    end
   end
 
+  @doc """
+  Discards the cached reference advertisement of the given `agent`.
+  """
+  @spec reference_discovery_reset(GitAgent.agent) :: :ok
+  def reference_discovery_reset(agent), do: GitAgent.invalidate(agent, :reference_discovery)
+
   @doc """
   Returns the given `data` formatted as *PKT-LINE*
   """
@@ -118,6 +128,7 @@ defmodule GitRekt.WireProtocol do
   def pkt_line({:ack, oid, status}), do: pkt_line("ACK #{Git.oid_fmt(oid)} #{status}")
   def pkt_line(:nak), do: pkt_line("NAK")
   def pkt_line(<<"PACK", _rest::binary>> = pack), do: pack
+  def pkt_line({:encoded, data}), do: data
   def pkt_line(data) when is_binary(data) do
     data
     |> byte_size()
@@ -212,7 +223,56 @@ defmodule GitRekt.WireProtocol do
   defp server_capabilities("git-receive-pack"), do: [server_agent_capability()|@receive_caps]
   defp server_capabilities("git-upload-pack"), do: [server_agent_capability()|@upload_caps]
 
-  defp format_ref_line(%GitRef{oid: oid, prefix: prefix, name: name}), do: "#{Git.oid_fmt(oid)} #{prefix <> name}"
+  defp format_ref_line({ref, nil}), do: format_ref_line(ref)
+  defp format_ref_line({%GitRef{prefix: prefix, name: name} = ref, peeled}), do: format_ref_line(ref) ++ ["#{Git.oid_fmt(peeled)} #{prefix <> name}^{}"]
+  defp format_ref_line(%GitRef{oid: oid, prefix: prefix, name: name}), do: ["#{Git.oid_fmt(oid)} #{prefix <> name}"]
+
+  defp reference_advertisement(agent) do
+    {:ok, path} = GitAgent.path(agent)
+    fingerprint = refdb_fingerprint(path)
+    case GitAgent.transaction(agent, :reference_discovery, &reference_advertisement(&1, fingerprint)) do
+      {:ok, {^fingerprint, advertisement}} ->
+        advertisement
+      {:ok, {_fingerprint, _advertisement}} ->
+        :ok = reference_discovery_reset(agent)
+        {:ok, {_fingerprint, advertisement}} = GitAgent.transaction(agent, :reference_discovery, &reference_advertisement(&1, fingerprint))
+        advertisement
+    end
+  end
+
+  defp reference_advertisement(agent, fingerprint) do
+    {:ok, refs} = GitAgent.references_peeled(agent)
+    [reference_head(agent)|refs]
+    |> List.flatten()
+    |> Enum.flat_map(&format_ref_line/1)
+    |> case do
+      [first_line|lines] ->
+        {:ok, {fingerprint, {first_line, IO.iodata_to_binary(encode(lines))}}}
+      [] ->
+        {:ok, {fingerprint, nil}}
+    end
+  end
+
+  defp refdb_fingerprint(path) do
+    now = System.os_time(:second)
+    stats = Enum.map(["HEAD", "packed-refs", "refs", "refs/heads", "refs/tags"], &refdb_stat(path, &1))
+    # mtimes have a one-second granularity, a write happening later within the same second would go unnoticed
+    if Enum.any?(stats, &refdb_stat_racy?(&1, now)),
+      do: make_ref(),
+    else: :crypto.hash(:sha, :erlang.term_to_binary(stats))
+  end
+
+  defp refdb_stat(path, name) do
+    case File.stat(Path.join(path, name), time: :posix) do
+      {:ok, %File.Stat{type: type, inode: inode, mtime: mtime, size: size}} ->
+        {name, type, inode, mtime, size}
+      {:error, reason} ->
+        {name, reason}
+    end
+  end
+
+  defp refdb_stat_racy?({_name, _type, _inode, mtime, _size}, now), do: mtime >= now - 1
+  defp refdb_stat_racy?({_name, _reason}, _now), do: false
 
   defp reference_head(agent) do
     case GitAgent.head(agent) do
@@ -1,6 +1,19 @@
 defmodule GitRekt.WireProtocol.ReceivePack do
   @moduledoc """
   Module implementing the `git-receive-pack` command.
+
+  After each push, loose references are packed into the `packed-refs` file once their count reaches the
+  `:loose_refs_threshold` (defaults to 1000), keeping reference iteration fast on repositories with many refs.
+  Loose references are counted by listing `refs/heads`, `refs/tags` and the directories of the pushed refs,
+  without stat'ing each file. Packing runs in the background, once the push has been applied, so it does not
+  delay the status report.
+
+  ## Telemetry
+
+  Following events are emitted:
+
+  * `[:gitrekt, :refdb, :loose_refs]` -- after each push, with the `count` of loose references.
+  * `[:gitrekt, :refdb, :compress]` -- when loose references are packed, with `count` and `duration` measurements.
   """
 
   @behaviour GitRekt.WireProtocol
@@ -11,12 +24,14 @@ defmodule GitRekt.WireProtocol.ReceivePack do
 
   require Logger
 
-  import GitRekt.WireProtocol, only: [reference_discovery: 3]
+  import GitRekt.WireProtocol, only: [reference_discovery: 3, reference_discovery_reset: 1]
 
   @service_name "git-receive-pack"
 
   @null_oid String.duplicate("0", 40)
 
+  @loose_refs_threshold Application.compile_env(:gitrekt, [__MODULE__, :loose_refs_threshold], 1_000)
+
   defstruct [
     agent: nil,
     state: :disco,
@@ -99,9 +114,11 @@ defmodule GitRekt.WireProtocol.ReceivePack do
   def next(%__MODULE__{state: :done} = handle, []) do
     if handle.cmds != [] do
       with  :ok <- push_pack(handle.agent, handle.writepack, handle.writepack_progress),
-            :ok <- push_cmds(handle.agent, handle.cmds),
-           {:ok, repo} <- GitRepo.push(handle.repo, handle.cmds) do
-        {%{handle|repo: repo}, [], report_status(handle)}
+            results = push_cmds(handle.agent, handle.cmds, "atomic" in handle.caps),
+            :ok <- reference_discovery_reset(handle.agent),
+           {:ok, repo} <- GitRepo.push(handle.repo, for({cmd, :ok} <- results, do: cmd)) do
+        :ok = compress_refs_async(handle.agent)
+        {%{handle|repo: repo}, [], report_status(handle, results)}
       else
         {:error, reason} ->
           {handle, [], ["unpack #{inspect reason}"]}
@@ -142,12 +159,16 @@ defmodule GitRekt.WireProtocol.ReceivePack do
     end
   end
 
-  defp report_status(%__MODULE__{caps: caps, cmds: cmds}) do
+  defp report_status(%__MODULE__{caps: caps}, results) do
     if "report-status" in caps,
-      do: List.flatten(["unpack ok", Enum.map(cmds, &"ok #{elem(&1, :erlang.tuple_size(&1)-1)}"), :flush]),
+      do: List.flatten(["unpack ok", Enum.map(results, &report_cmd_status/1), :flush]),
     else: []
   end
 
+  defp report_cmd_status({cmd, :ok}), do: "ok #{elem(cmd, :erlang.tuple_size(cmd)-1)}"
+  defp report_cmd_status({cmd, {:error, reason}}) when is_exception(reason), do: "ng #{elem(cmd, :erlang.tuple_size(cmd)-1)} #{Exception.message(reason)}"
+  defp report_cmd_status({cmd, {:error, reason}}), do: "ng #{elem(cmd, :erlang.tuple_size(cmd)-1)} #{inspect reason}"
+
   defp push_pack(_agent, _writepack, progress) when progress.received_bytes == 0, do: :ok
   defp push_pack(agent, writepack, progress) do
     case GitAgent.odb_writepack_commit(agent, writepack, progress) do
@@ -158,11 +179,58 @@ defmodule GitRekt.WireProtocol.ReceivePack do
     end
   end
 
-  defp push_cmds(agent, cmds) do
-    GitAgent.transaction(agent, fn agent -> Enum.each(cmds, &push_cmd(agent, &1)) end)
+  defp push_cmds(agent, cmds, atomic?) do
+    case GitAgent.reference_transaction(agent, Enum.map(cmds, &push_update/1)) do
+      :ok ->
+        Enum.map(cmds, &{&1, :ok})
+      {:error, reason} when atomic? ->
+        Enum.map(cmds, &{&1, {:error, reason}})
+      {:error, _reason} ->
+        Enum.map(cmds, &{&1, GitAgent.reference_transaction(agent, [push_update(&1)])})
+    end
   end
 
-  defp push_cmd(agent, {:create, new_oid, name}), do: :ok = GitAgent.reference_create(agent, name, :oid, new_oid)
-  defp push_cmd(agent, {:update, _old_oid, new_oid, name}), do: :ok = GitAgent.reference_create(agent, name, :oid, new_oid, force: true)
-  defp push_cmd(agent, {:delete, _old_oid, name}), do: :ok = GitAgent.reference_delete(agent, name)
+  defp push_update({:create, new_oid, name}), do: {name, nil, new_oid}
+  defp push_update({:update, old_oid, new_oid, name}), do: {name, old_oid, new_oid}
+  defp push_update({:delete, old_oid, name}), do: {name, old_oid, nil}
+
+  defp compress_refs_async(agent) when is_pid(agent) do
+    {:ok, _pid} = Task.start(fn -> compress_refs(agent) end)
+    :ok
+  end
+
+  defp compress_refs_async(agent), do: compress_refs(agent)
+
+  defp compress_refs(agent) do
+    {:ok, path} = GitAgent.path(agent)
+    loose_refs = count_loose_refs(Path.join(path, "refs"))
+    :telemetry.execute([:gitrekt, :refdb, :loose_refs], %{count: loose_refs}, %{path: path})
+    if loose_refs >= @loose_refs_threshold do
+      event_time = :os.system_time(:microsecond)
+      case GitAgent.refdb_compress(agent) do
+        :ok ->
+          :telemetry.execute([:gitrekt, :refdb, :compress], %{count: loose_refs, duration: :os.system_time(:microsecond) - event_time}, %{path: path})
+        {:error, reason} ->
+          Logger.warn("failed to pack #{loose_refs} loose refs in #{path}: #{inspect reason}")
+      end
+    end
+    :ok
+  end
+
+  defp count_loose_refs(dir) do
+    case File.ls(dir) do
+      {:ok, entries} ->
+        Enum.reduce(entries, 0, fn entry, acc ->
+          path = Path.join(dir, entry)
+          case File.lstat(path) do
+            {:ok, %File.Stat{type: :directory}} -> acc + count_loose_refs(path)
+            {:ok, %File.Stat{type: :regular}} -> acc + 1
+            {:ok, %File.Stat{}} -> acc
+            {:error, _reason} -> acc
+          end
+        end)
+      {:error, _reason} ->
+        0
+    end
+  end
 end
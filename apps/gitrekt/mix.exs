@@ -18,7 +18,7 @@ defmodule GitRekt.Mixfile do
   end
 
   def application do
-    [extra_applications: [:logger]]
+    [extra_applications: [:logger, :crypto]]
   end
 
   #